@@ -0,0 +1,147 @@
+// Packing neighbourhoods and running the network back to back (Forward) versus
+// packing the next batch while the worker runs the last one (ForwardAsync),
+// over the interior of a synthetic image.
+//
+//   AsyncForward [--width 1920] [--height 1080] [--rows-per-batch 8]
+//                [--frames 5]
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "ImageFilter.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Packs image rows [y, y + rows) into one batch of 8-bit neighbourhoods
+ByteMatrix packRows(const cv::Mat& img, int y, int rows) {
+  int width = img.cols - 2;
+  ByteMatrix batch(static_cast<size_t>(rows) * width, 27);
+  for (int r = 0; r < rows; r++) {
+    for (int x = 1; x <= width; x++) {
+      gatherNeighbourhood(img, y + r, x,
+                          &batch(static_cast<size_t>(r) * width + x - 1, 0));
+    }
+  }
+  return batch;
+}
+
+void unpackRows(const Matrix& outputs, cv::Mat& out, int y, int rows) {
+  ByteMatrix pixels(0, 0);
+  pixels.quantize(outputs);
+  int width = out.cols - 2;
+  for (int r = 0; r < rows; r++) {
+    std::memcpy(out.ptr<uchar>(y + r) + 3,
+                pixels.data() + static_cast<size_t>(r) * width * 3, 3 * width);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int width = 1920, height = 1080, rows_per_batch = 8, frames = 5;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return 1;
+    }
+    if (arg == "--width") {
+      width = std::stoi(argv[++i]);
+    } else if (arg == "--height") {
+      height = std::stoi(argv[++i]);
+    } else if (arg == "--rows-per-batch") {
+      rows_per_batch = std::stoi(argv[++i]);
+    } else if (arg == "--frames") {
+      frames = std::stoi(argv[++i]);
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  if (width < 3 || height < 3 || rows_per_batch < 1 || frames < 1) {
+    std::cerr << "Images must be at least 3x3, rows per batch and frames at "
+                 "least 1."
+              << std::endl;
+    return 1;
+  }
+
+  std::mt19937 gen(42);
+  cv::Mat image(height, width, CV_8UC3);
+  for (int y = 0; y < height; y++) {
+    uchar* row = image.ptr<uchar>(y);
+    for (int i = 0; i < 3 * width; i++) row[i] = gen() & 0xFF;
+  }
+  cv::Mat sync_out(height, width, CV_8UC3), async_out(height, width, CV_8UC3);
+
+  // Same network as main.cpp
+  Network network(nullptr, 1);
+  LayerDense layer1(27, 9, ActivationMethod::Sigmoid);
+  LayerDense layer2(9, 6, ActivationMethod::ReLU);
+  LayerDense layer3(6, 3, ActivationMethod::Softmax);
+  network.AddLayer(&layer1);
+  network.AddLayer(&layer2);
+  network.AddLayer(&layer3);
+
+  auto batchRows = [&](int y) {
+    return std::min(rows_per_batch, height - 1 - y);
+  };
+
+  Clock::time_point start = Clock::now();
+  for (int frame = 0; frame < frames; frame++) {
+    for (int y = 1; y < height - 1; y += rows_per_batch) {
+      network.Forward(packRows(image, y, batchRows(y)));
+      unpackRows(*network.outputs, sync_out, y, batchRows(y));
+    }
+  }
+  double sync_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  // Up to kAsyncSlots + 1 batches are queued or running while the next one
+  // is packed; the oldest is unpacked once the queue is full
+  start = Clock::now();
+  for (int frame = 0; frame < frames; frame++) {
+    std::deque<std::pair<int, std::future<Matrix>>> pending;
+    for (int y = 1; y < height - 1; y += rows_per_batch) {
+      pending.emplace_back(
+          y, network.ForwardAsync(packRows(image, y, batchRows(y))));
+      if (pending.size() > Network::kAsyncSlots) {
+        auto& [done_y, result] = pending.front();
+        unpackRows(result.get(), async_out, done_y, batchRows(done_y));
+        pending.pop_front();
+      }
+    }
+    for (auto& [done_y, result] : pending) {
+      unpackRows(result.get(), async_out, done_y, batchRows(done_y));
+    }
+  }
+  double async_seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  bool identical = true;
+  for (int y = 1; y < height - 1; y++) {
+    identical &= std::memcmp(sync_out.ptr<uchar>(y) + 3,
+                             async_out.ptr<uchar>(y) + 3,
+                             3 * (width - 2)) == 0;
+  }
+
+  double pixels = static_cast<double>(width - 2) * (height - 2) * frames;
+  std::cout << width << "x" << height << ", " << rows_per_batch
+            << " image rows per batch, " << frames << " frames" << std::endl;
+  std::cout << "Forward:      " << pixels / sync_seconds / 1e6 << " MP/s"
+            << std::endl;
+  std::cout << "ForwardAsync: " << pixels / async_seconds / 1e6 << " MP/s ("
+            << sync_seconds / async_seconds << "x)" << std::endl;
+  if (!identical) {
+    std::cerr << "Async outputs differ from Forward." << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+// Small benchmark harness shared by the programs in bench/.
+//
+// Each case is warmed up, calibrated so one sample runs for at least
+// kMinSampleSeconds, then sampled a fixed number of times. The median sample
+// is the headline figure; min, mean and standard deviation show the noise.
+// Results can be written to JSON and compared against a saved baseline.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Keeps the compiler from discarding a result the benchmark never reads
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#ifdef _MSC_VER
+  static volatile const void* sink;
+  sink = &value;
+#else
+  asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
+
+// Work done by one call of a case, used to derive throughput. Leave a field at
+// zero when it doesn't apply.
+struct BenchmarkWork {
+  double Flops = 0.0;
+  double Elements = 0.0;
+  double Bytes = 0.0;
+};
+
+struct BenchmarkResult {
+  std::string Name;
+  size_t Samples = 0;
+  size_t Iterations = 0;  // calls per sample
+  double MedianNs = 0.0, MinNs = 0.0, MeanNs = 0.0, StdDevNs = 0.0;
+  BenchmarkWork Work;
+
+  double gflops() const { return Work.Flops / MedianNs; }
+  double nsPerElement() const { return MedianNs / Work.Elements; }
+  double bytesPerSecond() const { return Work.Bytes / MedianNs * 1e9; }
+};
+
+class BenchmarkSuite {
+ public:
+  static constexpr double kMinSampleSeconds = 1e-3;
+
+ private:
+  std::vector<BenchmarkResult> m_results;
+  std::string m_filter;
+  size_t m_samples;
+  double m_warmupSeconds;
+
+  template <typename Fn>
+  static double secondsFor(Fn& fn, size_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+  }
+
+ public:
+  explicit BenchmarkSuite(size_t samples = 21, double warmupSeconds = 0.02)
+      : m_samples(samples), m_warmupSeconds(warmupSeconds) {}
+
+  // Only cases whose name contains the filter are run
+  void setFilter(const std::string& filter) { m_filter = filter; }
+  const std::vector<BenchmarkResult>& results() const { return m_results; }
+
+  template <typename Fn>
+  void run(const std::string& name, const BenchmarkWork& work, Fn fn) {
+    if (name.find(m_filter) == std::string::npos) return;
+
+    // Warm up caches, branch predictors and lazily allocated buffers
+    auto warmupEnd = std::chrono::steady_clock::now() +
+                     std::chrono::duration<double>(m_warmupSeconds);
+    do {
+      fn();
+    } while (std::chrono::steady_clock::now() < warmupEnd);
+
+    size_t iterations = 1;
+    while (secondsFor(fn, iterations) < kMinSampleSeconds) iterations *= 2;
+
+    std::vector<double> samples(m_samples);
+    for (double& sample : samples) {
+      sample = secondsFor(fn, iterations) * 1e9 / iterations;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    BenchmarkResult result;
+    result.Name = name;
+    result.Samples = samples.size();
+    result.Iterations = iterations;
+    result.MedianNs = samples[samples.size() / 2];
+    result.MinNs = samples.front();
+    for (double sample : samples) result.MeanNs += sample;
+    result.MeanNs /= samples.size();
+    for (double sample : samples) {
+      result.StdDevNs += (sample - result.MeanNs) * (sample - result.MeanNs);
+    }
+    result.StdDevNs = std::sqrt(result.StdDevNs / samples.size());
+    result.Work = work;
+
+    print(result);
+    m_results.push_back(result);
+  }
+
+  static void print(const BenchmarkResult& result) {
+    std::cout << std::left << std::setw(44) << result.Name << std::right
+              << std::fixed << std::setprecision(1) << std::setw(12)
+              << result.MedianNs << " ns  +-" << std::setw(5)
+              << 100.0 * result.StdDevNs / result.MeanNs << "%";
+    if (result.Work.Flops > 0) {
+      std::cout << std::setprecision(3) << std::setw(9) << result.gflops()
+                << " GFLOP/s";
+    }
+    if (result.Work.Elements > 0) {
+      std::cout << std::setprecision(2) << std::setw(10)
+                << result.nsPerElement() << " ns/elem";
+    }
+    if (result.Work.Bytes > 0) {
+      std::cout << std::setprecision(2) << std::setw(9)
+                << result.bytesPerSecond() / 1e9 << " GB/s";
+    }
+    std::cout << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+  }
+
+  void writeJson(std::ostream& out) const {
+    out << "{\"benchmarks\": [";
+    for (size_t i = 0; i < m_results.size(); i++) {
+      const BenchmarkResult& r = m_results[i];
+      out << (i > 0 ? "," : "") << "\n  {";
+      out << "\"name\": \"" << r.Name << "\", ";
+      out << "\"samples\": " << r.Samples << ", ";
+      out << "\"iterations\": " << r.Iterations << ", ";
+      out << "\"median_ns\": " << r.MedianNs << ", ";
+      out << "\"min_ns\": " << r.MinNs << ", ";
+      out << "\"mean_ns\": " << r.MeanNs << ", ";
+      out << "\"stddev_ns\": " << r.StdDevNs << ", ";
+      out << "\"flops\": " << r.Work.Flops << ", ";
+      out << "\"elements\": " << r.Work.Elements << ", ";
+      out << "\"bytes\": " << r.Work.Bytes << "}";
+    }
+    out << "\n]}\n";
+  }
+
+  // Reads the median of every case from a file written by writeJson
+  static std::map<std::string, double> readBaseline(std::istream& in) {
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string text = buffer.str();
+
+    std::map<std::string, double> medians;
+    const std::string nameKey = "\"name\": \"";
+    const std::string medianKey = "\"median_ns\": ";
+    size_t pos = 0;
+    while ((pos = text.find(nameKey, pos)) != std::string::npos) {
+      size_t nameStart = pos + nameKey.size();
+      size_t nameEnd = text.find('"', nameStart);
+      size_t median = text.find(medianKey, nameEnd);
+      if (nameEnd == std::string::npos || median == std::string::npos) break;
+      medians[text.substr(nameStart, nameEnd - nameStart)] =
+          std::stod(text.substr(median + medianKey.size()));
+      pos = median;
+    }
+    return medians;
+  }
+
+  // Prints the change in median for every case in both runs and returns how
+  // many got slower by more than threshold (0.1 = 10%)
+  size_t compare(const std::map<std::string, double>& baseline,
+                 double threshold) const {
+    size_t regressions = 0;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const BenchmarkResult& result : m_results) {
+      auto it = baseline.find(result.Name);
+      if (it == baseline.end()) continue;
+
+      double change = result.MedianNs / it->second - 1.0;
+      const char* verdict = "";
+      if (change > threshold) {
+        verdict = "  REGRESSION";
+        regressions++;
+      } else if (change < -threshold) {
+        verdict = "  improved";
+      }
+      std::cout << std::left << std::setw(44) << result.Name << std::right
+                << std::setw(12) << it->second << " -> " << std::setw(12)
+                << result.MedianNs << " ns " << std::showpos << std::setw(7)
+                << 100.0 * change << "%" << std::noshowpos << verdict
+                << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    return regressions;
+  }
+};
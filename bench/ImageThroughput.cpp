@@ -0,0 +1,283 @@
+// End-to-end throughput of the processImage path (decode, pack, infer, unpack,
+// encode) on synthetic images, so it runs without any files on disk.
+//
+//   ImageThroughput [--width 1920] [--height 1080] [--frames 5]
+//                   [--content noise|flat|gradient|natural|all]
+//                   [--codec none|png|jpg] [--seed 42] [--network file.bin]
+//
+// Without --network the 27 -> 9 -> 6 -> 3 network main.cpp builds is
+// initialised from --seed, so runs are repeatable. Nothing is written.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ImageFilter.h"
+#include "Instrumentor.h"
+
+namespace {
+
+// Stages timed by PROFILE_SCOPEs in filterImage and in this file
+const std::vector<std::string> kStages = {
+    "ImageThroughput decode", "filterImage pack", "filterImage infer",
+    "filterImage unpack", "ImageThroughput encode"};
+
+cv::Mat makeNoise(int height, int width, std::mt19937& gen) {
+  cv::Mat img(height, width, CV_8UC3);
+  for (int y = 0; y < height; y++) {
+    uchar* row = img.ptr<uchar>(y);
+    for (int i = 0; i < 3 * width; i++) row[i] = gen() & 0xFF;
+  }
+  return img;
+}
+
+cv::Mat makeFlat(int height, int width, std::mt19937& gen) {
+  uchar colour[3] = {static_cast<uchar>(gen() & 0xFF),
+                     static_cast<uchar>(gen() & 0xFF),
+                     static_cast<uchar>(gen() & 0xFF)};
+  cv::Mat img(height, width, CV_8UC3);
+  for (int y = 0; y < height; y++) {
+    uchar* row = img.ptr<uchar>(y);
+    for (int x = 0; x < width; x++) {
+      for (int ch = 0; ch < 3; ch++) row[3 * x + ch] = colour[ch];
+    }
+  }
+  return img;
+}
+
+cv::Mat makeGradient(int height, int width, std::mt19937&) {
+  cv::Mat img(height, width, CV_8UC3);
+  for (int y = 0; y < height; y++) {
+    uchar* row = img.ptr<uchar>(y);
+    for (int x = 0; x < width; x++) {
+      row[3 * x + 0] = static_cast<uchar>(255 * x / std::max(width - 1, 1));
+      row[3 * x + 1] = static_cast<uchar>(255 * y / std::max(height - 1, 1));
+      row[3 * x + 2] = static_cast<uchar>(
+          255 * (x + y) / std::max(width + height - 2, 1));
+    }
+  }
+  return img;
+}
+
+// Fractal value noise: smooth regions at several scales, a little sensor
+// noise and a few hard-edged shapes, so neighbourhoods repeat about as often
+// as they do in photographs
+cv::Mat makeNatural(int height, int width, std::mt19937& gen) {
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::vector<double> value(static_cast<size_t>(height) * width * 3, 0.0);
+
+  double amplitude = 0.5;
+  for (int cell = std::max(width, height) / 4; cell >= 4; cell /= 2) {
+    int gridW = width / cell + 2, gridH = height / cell + 2;
+    std::vector<double> grid(static_cast<size_t>(gridW) * gridH * 3);
+    for (double& g : grid) g = unit(gen);
+
+    for (int y = 0; y < height; y++) {
+      int gy = y / cell;
+      double fy = static_cast<double>(y % cell) / cell;
+      for (int x = 0; x < width; x++) {
+        int gx = x / cell;
+        double fx = static_cast<double>(x % cell) / cell;
+        for (int ch = 0; ch < 3; ch++) {
+          auto at = [&](int cx, int cy) {
+            return grid[(static_cast<size_t>(cy) * gridW + cx) * 3 + ch];
+          };
+          double top = at(gx, gy) * (1 - fx) + at(gx + 1, gy) * fx;
+          double bottom = at(gx, gy + 1) * (1 - fx) + at(gx + 1, gy + 1) * fx;
+          value[(static_cast<size_t>(y) * width + x) * 3 + ch] +=
+              amplitude * (top * (1 - fy) + bottom * fy);
+        }
+      }
+    }
+    amplitude *= 0.5;
+  }
+
+  cv::Mat img(height, width, CV_8UC3);
+  std::normal_distribution<double> grain(0.0, 2.0);
+  for (int y = 0; y < height; y++) {
+    uchar* row = img.ptr<uchar>(y);
+    for (int i = 0; i < 3 * width; i++) {
+      double v = 255.0 * value[static_cast<size_t>(y) * width * 3 + i];
+      row[i] = static_cast<uchar>(std::clamp(v + grain(gen), 0.0, 255.0));
+    }
+  }
+
+  for (int shape = 0; shape < 8; shape++) {
+    int x0 = static_cast<int>(gen() % width);
+    int y0 = static_cast<int>(gen() % height);
+    int x1 =
+        std::min(width, x0 + 1 + static_cast<int>(gen() % (width / 4 + 1)));
+    int y1 =
+        std::min(height, y0 + 1 + static_cast<int>(gen() % (height / 4 + 1)));
+    cv::Vec3b colour(gen() & 0xFF, gen() & 0xFF, gen() & 0xFF);
+    for (int y = y0; y < y1; y++) {
+      for (int x = x0; x < x1; x++) img.at<cv::Vec3b>(y, x) = colour;
+    }
+  }
+  return img;
+}
+
+cv::Mat makeImage(const std::string& content, int height, int width,
+                  std::mt19937& gen) {
+  if (content == "noise") return makeNoise(height, width, gen);
+  if (content == "flat") return makeFlat(height, width, gen);
+  if (content == "gradient") return makeGradient(height, width, gen);
+  return makeNatural(height, width, gen);
+}
+
+void seedLayer(LayerDense& layer, std::mt19937& gen) {
+  std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+  Matrix weights = layer.getWeights();
+  for (size_t i = 0; i < weights.numRows(); i++) {
+    for (size_t j = 0; j < weights.numColumns(); j++) {
+      weights(i, j) = distribution(gen);
+    }
+  }
+  layer.setWeights(weights);
+}
+
+std::vector<long long> stageTimes(const std::vector<uint32_t>& ids) {
+  std::vector<long long> times;
+  for (uint32_t id : ids) {
+    times.push_back(Instrumentor::Get().GetFunctionTime(id));
+  }
+  return times;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int width = 1920, height = 1080, frames = 5;
+  unsigned seed = 42;
+  std::string content = "all", codec = "none", network_filename;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return 1;
+    }
+    if (arg == "--width") {
+      width = std::stoi(argv[++i]);
+    } else if (arg == "--height") {
+      height = std::stoi(argv[++i]);
+    } else if (arg == "--frames") {
+      frames = std::stoi(argv[++i]);
+    } else if (arg == "--content") {
+      content = argv[++i];
+    } else if (arg == "--codec") {
+      codec = argv[++i];
+    } else if (arg == "--seed") {
+      seed = static_cast<unsigned>(std::stoul(argv[++i]));
+    } else if (arg == "--network") {
+      network_filename = argv[++i];
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  if (width < 3 || height < 3 || frames < 1) {
+    std::cerr << "Images must be at least 3x3 and frames at least 1."
+              << std::endl;
+    return 1;
+  }
+  if (codec != "none" && codec != "png" && codec != "jpg") {
+    std::cerr << "Unknown codec: " << codec << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> contents = {content};
+  if (content == "all") contents = {"noise", "flat", "gradient", "natural"};
+  for (const std::string& c : contents) {
+    if (c != "noise" && c != "flat" && c != "gradient" && c != "natural") {
+      std::cerr << "Unknown content: " << c << std::endl;
+      return 1;
+    }
+  }
+
+  std::mt19937 gen(seed);
+
+  // Same network as main.cpp
+  Network network(nullptr, 1);
+  LayerDense layer1(27, 9, ActivationMethod::Sigmoid);
+  LayerDense layer2(9, 6, ActivationMethod::ReLU);
+  LayerDense layer3(6, 3, ActivationMethod::Softmax);
+  seedLayer(layer1, gen);
+  seedLayer(layer2, gen);
+  seedLayer(layer3, gen);
+  network.AddLayer(&layer1);
+  network.AddLayer(&layer2);
+  network.AddLayer(&layer3);
+
+  if (!network_filename.empty()) {
+    std::ifstream file_in(network_filename, std::ios::binary);
+    if (!file_in.good()) {
+      std::cerr << "Failed to open the file: " << network_filename << std::endl;
+      return 1;
+    }
+    network.Load(file_in);
+  }
+
+  // The stage scopes only time themselves when asked to (or in a session)
+  Instrumentor::Get().SetCollectFunctionTimes(true);
+  std::vector<uint32_t> stage_ids;
+  for (const std::string& stage : kStages) {
+    stage_ids.push_back(Instrumentor::Get().InternName(stage));
+  }
+  const std::string extension = "." + codec;
+
+  double pixels = static_cast<double>(width) * height;
+  std::cout << width << "x" << height << ", " << frames
+            << " frames per content, codec " << codec << std::endl;
+
+  for (const std::string& c : contents) {
+    cv::Mat image = makeImage(c, height, width, gen);
+    std::vector<uchar> encoded;
+    if (codec != "none") cv::imencode(extension, image, encoded);
+
+    // One untimed frame so first-touch allocations don't count
+    filterImage(network, image);
+
+    std::vector<long long> before = stageTimes(stage_ids);
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+      cv::Mat in_img = image;
+      if (codec != "none") {
+        PROFILE_SCOPE("ImageThroughput decode");
+        in_img = cv::imdecode(encoded, cv::IMREAD_COLOR);
+      }
+
+      cv::Mat out_img = filterImage(network, in_img);
+
+      if (codec != "none") {
+        PROFILE_SCOPE("ImageThroughput encode");
+        std::vector<uchar> out_encoded;
+        cv::imencode(extension, out_img, out_encoded);
+      }
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    std::vector<long long> after = stageTimes(stage_ids);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << c << ": " << pixels * frames / seconds / 1e6 << " MP/s, "
+              << 1000.0 * seconds / frames << " ms/frame" << std::endl;
+    for (size_t i = 0; i < kStages.size(); i++) {
+      double stage_seconds = (after[i] - before[i]) / 1e6;
+      if (stage_seconds == 0.0) continue;
+      std::cout << "  " << std::left << std::setw(24) << kStages[i]
+                << std::right << std::setw(10)
+                << 1000.0 * stage_seconds / frames << " ms/frame"
+                << std::setw(8) << 100.0 * stage_seconds / seconds << "%"
+                << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+  }
+  return 0;
+}
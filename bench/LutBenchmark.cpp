@@ -0,0 +1,60 @@
+// Compares the lookup-table kernel LayerDense uses for 8-bit inputs with the
+// GEMM path on the production first layer (27 -> 9, Sigmoid).
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "LayerDense.h"
+
+template <typename Fn>
+double timePerRun(Fn&& fn, int repetitions) {
+  fn();  // warm-up
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repetitions; i++) fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count() / repetitions;
+}
+
+int main(int argc, char* argv[]) {
+  size_t rows = argc > 1 ? std::stoul(argv[1]) : 1918;
+  int repetitions = argc > 2 ? std::stoi(argv[2]) : 200;
+
+  LayerDense layer(27, 9, ActivationMethod::Sigmoid);
+
+  std::mt19937 gen(42);
+  ByteMatrix bytes(rows, 27);
+  Matrix doubles(rows, 27);
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t k = 0; k < 27; k++) {
+      bytes(i, k) = static_cast<uint8_t>(gen() & 0xFF);
+      doubles(i, k) = bytes(i, k) / 255.0;
+    }
+  }
+
+  // GEMM path, including the byte to double conversion it needs
+  double gemm = timePerRun(
+      [&] {
+        Matrix converted(rows, 27);
+        for (size_t i = 0; i < rows * 27; i++) {
+          converted.data()[i] = bytes.data()[i] / 255.0;
+        }
+        layer.forward(converted);
+      },
+      repetitions);
+  Matrix expected = *layer.output;
+
+  double lut = timePerRun([&] { layer.forward(bytes); }, repetitions);
+  bool identical = std::memcmp(expected.data(), layer.output->data(),
+                               rows * 9 * sizeof(double)) == 0;
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "rows: " << rows << ", repetitions: " << repetitions
+            << std::endl;
+  std::cout << "GEMM:   " << gemm * 1e9 / rows << " ns/row" << std::endl;
+  std::cout << "LUT:    " << lut * 1e9 / rows << " ns/row" << std::endl;
+  std::cout << "speedup: " << gemm / lut << "x, outputs "
+            << (identical ? "identical" : "DIFFER") << std::endl;
+  return identical ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+// Micro-benchmarks for the building blocks of the image network: Matrix ops,
+// activations, dense layers, whole forward passes and model loading.
+//
+//   MicroBenchmarks [--filter text] [--json out.json]
+//                   [--compare baseline.json] [--threshold 0.1]
+//
+// With --compare the exit code is 1 if any case got slower than the baseline
+// by more than the threshold.
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <tuple>
+
+#include "Benchmark.h"
+#include "Network.h"
+
+namespace {
+
+constexpr double kDouble = sizeof(double);
+
+// Network::Save and Load print every layer; this swallows it
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+};
+
+class QuietStdout {
+ private:
+  NullBuffer m_null;
+  std::streambuf* m_saved;
+
+ public:
+  QuietStdout() : m_saved(std::cout.rdbuf(&m_null)) {}
+  ~QuietStdout() { std::cout.rdbuf(m_saved); }
+};
+
+void fillRandom(Matrix& matrix, std::mt19937& gen) {
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  for (size_t i = 0; i < matrix.numRows() * matrix.numColumns(); i++) {
+    matrix.data()[i] = dist(gen);
+  }
+}
+
+std::string shape(size_t rows, size_t cols) {
+  return std::to_string(rows) + "x" + std::to_string(cols);
+}
+
+const char* activationName(ActivationMethod method) {
+  switch (method) {
+    case ActivationMethod::ReLU:
+      return "ReLU";
+    case ActivationMethod::Sigmoid:
+      return "Sigmoid";
+    case ActivationMethod::Softmax:
+      return "Softmax";
+    default:
+      return "NONE";
+  }
+}
+
+void benchMatrix(BenchmarkSuite& suite, std::mt19937& gen) {
+  // Our layer widths, then square shapes where blocking would start to matter
+  const std::vector<std::pair<size_t, size_t>> widths = {
+      {27, 9}, {9, 6}, {6, 3}, {64, 64}, {256, 256}};
+  const std::vector<size_t> batches = {1, 64, 1024};
+
+  for (auto [inner, cols] : widths) {
+    for (size_t rows : batches) {
+      Matrix lhs(rows, inner), rhs(inner, cols);
+      fillRandom(lhs, gen);
+      fillRandom(rhs, gen);
+
+      double r = rows, k = inner, c = cols;
+      suite.run("Matrix::dotProduct " + shape(rows, inner) + "*" +
+                    shape(inner, cols),
+                {2 * r * k * c, r * c, kDouble * (r * k + k * c + r * c)},
+                [&] { doNotOptimize(Matrix::dotProduct(lhs, rhs)); });
+
+      // The same product evaluated into existing storage
+      Matrix out(rows, cols), bias(1, cols);
+      fillRandom(bias, gen);
+      suite.run("Matrix::gemm " + shape(rows, inner) + "*" + shape(inner, cols),
+                {2 * r * k * c, r * c, kDouble * (r * k + k * c + r * c)},
+                [&] {
+                  Matrix::gemm(1.0, lhs, rhs, 0.0, out);
+                  doNotOptimize(out);
+                });
+      suite.run("Matrix a*b+bias into c " + shape(rows, inner) + "*" +
+                    shape(inner, cols),
+                {2 * r * k * c + r * c, r * c,
+                 kDouble * (r * k + k * c + r * c + c)},
+                [&] {
+                  out = lhs * rhs + bias;
+                  doNotOptimize(out);
+                });
+
+      Matrix other(rows, inner);
+      fillRandom(other, gen);
+      suite.run("Matrix::add " + shape(rows, inner),
+                {r * k, r * k, kDouble * 3 * r * k},
+                [&] { doNotOptimize(Matrix::add(lhs, other)); });
+      suite.run("Matrix::transpose " + shape(rows, inner),
+                {0, r * k, kDouble * 2 * r * k},
+                [&] { doNotOptimize(lhs.transpose()); });
+    }
+  }
+}
+
+void benchActivations(BenchmarkSuite& suite, std::mt19937& gen) {
+  // NONE is left out: Activation::forward rejects it
+  for (ActivationMethod method :
+       {ActivationMethod::ReLU, ActivationMethod::Sigmoid,
+        ActivationMethod::Softmax}) {
+    for (auto [rows, cols] : std::vector<std::pair<size_t, size_t>>{
+             {1024, 9}, {1024, 6}, {1024, 3}}) {
+      Matrix input(rows, cols);
+      fillRandom(input, gen);
+      Activation activation(method);
+
+      double elements = static_cast<double>(rows * cols);
+      suite.run(std::string("Activation ") + activationName(method) + " " +
+                    shape(rows, cols),
+                {0, elements, kDouble * 2 * elements},
+                [&] { doNotOptimize(activation.forward(input)); });
+    }
+  }
+}
+
+void benchDense(BenchmarkSuite& suite, std::mt19937& gen) {
+  const std::vector<std::tuple<size_t, size_t, ActivationMethod>> layers = {
+      {27, 9, ActivationMethod::Sigmoid},
+      {9, 6, ActivationMethod::ReLU},
+      {6, 3, ActivationMethod::Softmax}};
+
+  for (auto [in, out, method] : layers) {
+    for (size_t rows : {1, 64, 1918}) {
+      LayerDense layer(in, out, method);
+      Matrix input(rows, in);
+      fillRandom(input, gen);
+
+      double r = rows, i = in, o = out;
+      BenchmarkWork work = {2 * r * i * o + r * o, r,
+                            kDouble * (r * i + i * o + r * o)};
+      std::string name = "LayerDense " + std::to_string(in) + "->" +
+                         std::to_string(out) + " batch " +
+                         std::to_string(rows);
+      suite.run(name, work, [&] { layer.forward(input); });
+
+      // The 8-bit input path (a lookup table for these widths)
+      ByteMatrix bytes(rows, in);
+      for (size_t k = 0; k < rows * in; k++) bytes.data()[k] = gen() & 0xFF;
+      work.Bytes = r * i + kDouble * (i * o + r * o);
+      suite.run(name + " uint8", work, [&] { layer.forward(bytes); });
+    }
+  }
+}
+
+// The 27 -> 9 -> 6 -> 3 network main.cpp runs over 3x3 neighbourhoods
+void addImageLayers(Network& network) {
+  network.AddLayer(new LayerDense(27, 9, ActivationMethod::Sigmoid));
+  network.AddLayer(new LayerDense(9, 6, ActivationMethod::ReLU));
+  network.AddLayer(new LayerDense(6, 3, ActivationMethod::Softmax));
+}
+
+void deleteLayers(Network& network) {
+  for (Layer* layer : network.GetLayers()) delete layer;
+}
+
+void benchNetwork(BenchmarkSuite& suite, std::mt19937& gen) {
+  const double flopsPerRow = 2 * (27 * 9 + 9 * 6 + 6 * 3) + (9 + 6 + 3);
+  const double bytesPerRow = kDouble * (27 + 9 + 6 + 3);
+
+  for (size_t rows : {1, 64, 1918, 16384, 262144}) {
+    Matrix input(rows, 27);
+    fillRandom(input, gen);
+    // Batch size 0 picks micro-batches from L2; rows runs the input whole
+    Network network(&input, 0);
+    addImageLayers(network);
+    Network unsplit(&input, static_cast<int>(rows));
+    for (Layer* layer : network.GetLayers()) unsplit.AddLayer(layer);
+
+    double r = rows;
+    BenchmarkWork work = {flopsPerRow * r, r, bytesPerRow * r};
+    std::string name = "Network::Forward batch " + std::to_string(rows);
+    suite.run(name, work, [&] { network.Forward(); });
+    if (network.MicroBatchRows() < rows) {
+      suite.run(name + " unsplit", work, [&] { unsplit.Forward(); });
+    }
+    deleteLayers(network);
+  }
+}
+
+void benchLoad(BenchmarkSuite& suite) {
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "bench_network.bin";
+  {
+    Matrix input(1, 27);
+    Network network(&input, 1);
+    addImageLayers(network);
+    std::ofstream file(path, std::ios::binary);
+    QuietStdout quiet;
+    network.Save(file);
+    deleteLayers(network);
+  }
+
+  const double parameters = 27 * 9 + 9 + 9 * 6 + 6 + 6 * 3 + 3;
+  const double fileBytes =
+      static_cast<double>(std::filesystem::file_size(path));
+
+  Network network(nullptr, 1);
+  suite.run("Network::Load", {0, parameters, fileBytes}, [&] {
+    QuietStdout quiet;
+    std::ifstream file(path, std::ios::binary);
+    network.Load(file);
+    deleteLayers(network);
+  });
+
+  std::filesystem::remove(path);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string filter, jsonPath, baselinePath;
+  double threshold = 0.1;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return 1;
+    }
+    if (arg == "--filter") {
+      filter = argv[++i];
+    } else if (arg == "--json") {
+      jsonPath = argv[++i];
+    } else if (arg == "--compare") {
+      baselinePath = argv[++i];
+    } else if (arg == "--threshold") {
+      threshold = std::stod(argv[++i]);
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  BenchmarkSuite suite;
+  suite.setFilter(filter);
+  std::mt19937 gen(42);
+
+  benchMatrix(suite, gen);
+  benchActivations(suite, gen);
+  benchDense(suite, gen);
+  benchNetwork(suite, gen);
+  benchLoad(suite);
+
+  if (!jsonPath.empty()) {
+    std::ofstream out(jsonPath);
+    if (!out.is_open()) {
+      std::cerr << "Failed to open the file: " << jsonPath << std::endl;
+      return 1;
+    }
+    suite.writeJson(out);
+  }
+
+  if (!baselinePath.empty()) {
+    std::ifstream in(baselinePath);
+    if (!in.is_open()) {
+      std::cerr << "Failed to open the file: " << baselinePath << std::endl;
+      return 1;
+    }
+    std::cout << std::endl
+              << "Compared with " << baselinePath << ":" << std::endl;
+    size_t regressions =
+        suite.compare(BenchmarkSuite::readBaseline(in), threshold);
+    if (regressions > 0) {
+      std::cout << regressions << " regression(s) beyond "
+                << 100.0 * threshold << "%" << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,156 @@
+// processImageStreaming against processImage on the same synthetic PPM: time,
+// peak memory, and whether the interiors of the two outputs match.
+//
+//   StreamingImage [--width 4096] [--height 4096] [--band-rows 64]
+//
+// The input and both outputs are written to a temporary directory and removed
+// afterwards. The streaming run goes first, since peak RSS only ever grows.
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "ImageFilter.h"
+#include "PpmStream.h"
+
+namespace {
+
+double peakResidentMB() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+// Noise, written a band at a time so the input never exists in memory whole
+void writeNoise(const std::string& filename, int height, int width) {
+  std::mt19937 gen(42);
+  PpmWriter writer(filename, height, width);
+  cv::Mat band(64, width, CV_8UC3);
+  for (int y = 0; y < height; y += band.rows) {
+    int rows = std::min(band.rows, height - y);
+    for (int r = 0; r < rows; r++) {
+      uchar* row = band.ptr<uchar>(r);
+      for (int i = 0; i < 3 * width; i++) row[i] = gen() & 0xFF;
+    }
+    writer.write(band, 0, rows);
+  }
+}
+
+bool interiorsMatch(const std::string& a, const std::string& b) {
+  PpmReader reader_a(a), reader_b(b);
+  if (reader_a.rows() != reader_b.rows() ||
+      reader_a.cols() != reader_b.cols()) {
+    return false;
+  }
+  int cols = reader_a.cols();
+  cv::Mat row_a(1, cols, CV_8UC3), row_b(1, cols, CV_8UC3);
+  for (int y = 0; y < reader_a.rows(); y++) {
+    reader_a.read(row_a, 0, 1);
+    reader_b.read(row_b, 0, 1);
+    if (y == 0 || y == reader_a.rows() - 1) continue;
+    if (std::memcmp(row_a.ptr<uchar>(0) + 3, row_b.ptr<uchar>(0) + 3,
+                    3 * static_cast<size_t>(cols - 2)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int width = 4096, height = 4096, band_rows = 64;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return 1;
+    }
+    if (arg == "--width") {
+      width = std::stoi(argv[++i]);
+    } else if (arg == "--height") {
+      height = std::stoi(argv[++i]);
+    } else if (arg == "--band-rows") {
+      band_rows = std::stoi(argv[++i]);
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  if (width < 3 || height < 3 || band_rows < 1) {
+    std::cerr << "Images must be at least 3x3 and bands at least 1 row."
+              << std::endl;
+    return 1;
+  }
+
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "streaming_image_bench";
+  std::filesystem::create_directories(directory);
+  std::string input = (directory / "input.ppm").string();
+  std::string streamed = (directory / "streamed.ppm").string();
+  std::string whole = (directory / "whole.ppm").string();
+
+  // Same network as main.cpp
+  Network network(nullptr, 1);
+  LayerDense layer1(27, 9, ActivationMethod::Sigmoid);
+  LayerDense layer2(9, 6, ActivationMethod::ReLU);
+  LayerDense layer3(6, 3, ActivationMethod::Softmax);
+  network.AddLayer(&layer1);
+  network.AddLayer(&layer2);
+  network.AddLayer(&layer3);
+
+  try {
+    writeNoise(input, height, width);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  // One untimed pass over a single row so the first layer's lookup table
+  // isn't built inside the streaming timing
+  filterImage(network, cv::Mat(3, width, CV_8UC3));
+  double baseline_mb = peakResidentMB();
+
+  auto start = std::chrono::steady_clock::now();
+  processImageStreaming(network, input, streamed, band_rows);
+  double stream_seconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+  double stream_mb = peakResidentMB();
+
+  start = std::chrono::steady_clock::now();
+  processImage(network, input, whole);
+  double whole_seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  double whole_mb = peakResidentMB();
+
+  bool identical = false;
+  try {
+    identical = interiorsMatch(streamed, whole);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+  std::filesystem::remove_all(directory);
+
+  double pixels = static_cast<double>(width) * height;
+  std::cout << width << "x" << height << ", " << band_rows
+            << " rows per band" << std::endl;
+  std::cout << "processImage:          " << pixels / whole_seconds / 1e6
+            << " MP/s, peak RSS " << whole_mb << " MB" << std::endl;
+  std::cout << "processImageStreaming: " << pixels / stream_seconds / 1e6
+            << " MP/s, peak RSS " << stream_mb << " MB ("
+            << stream_mb - baseline_mb << " MB over the baseline)"
+            << std::endl;
+  if (!identical) {
+    std::cerr << "Streamed output differs from processImage." << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,137 @@
+// Throughput of TrainingDataPipeline, optionally with a forward pass per
+// batch standing in for the training step, and how long the consumer waited
+// on it.
+//
+//   TrainingDataThroughput [--inputs glob --targets glob] [--batch 256]
+//                          [--shuffle 65536] [--threads 2] [--prefetch 8]
+//                          [--epochs 1] [--forward]
+//
+// Without --inputs and --targets, 8 synthetic 640x480 PNG pairs are written to
+// a temporary directory and removed afterwards.
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "Network.h"
+#include "TrainingData.h"
+
+namespace {
+
+std::vector<TrainingDataPipeline::ImagePair> writeSyntheticPairs(
+    const std::filesystem::path& directory) {
+  std::filesystem::create_directories(directory);
+  std::mt19937 gen(42);
+  std::vector<TrainingDataPipeline::ImagePair> pairs;
+
+  for (int i = 0; i < 8; i++) {
+    cv::Mat input(480, 640, CV_8UC3), target(480, 640, CV_8UC3);
+    for (int y = 0; y < input.rows; y++) {
+      uchar* in_row = input.ptr<uchar>(y);
+      uchar* target_row = target.ptr<uchar>(y);
+      for (int k = 0; k < 3 * input.cols; k++) {
+        in_row[k] = gen() & 0xFF;
+        target_row[k] = 255 - in_row[k];
+      }
+    }
+    std::string name = std::to_string(i) + ".png";
+    pairs.push_back({(directory / ("input" + name)).string(),
+                     (directory / ("target" + name)).string()});
+    cv::imwrite(pairs.back().Input, input);
+    cv::imwrite(pairs.back().Target, target);
+  }
+  return pairs;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string inputs, targets;
+  TrainingDataOptions options;
+  bool forward = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--forward") {
+      forward = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return 1;
+    }
+    if (arg == "--inputs") {
+      inputs = argv[++i];
+    } else if (arg == "--targets") {
+      targets = argv[++i];
+    } else if (arg == "--batch") {
+      options.BatchSize = std::stoul(argv[++i]);
+    } else if (arg == "--shuffle") {
+      options.ShuffleBuffer = std::stoul(argv[++i]);
+    } else if (arg == "--threads") {
+      options.DecodeThreads = std::stoul(argv[++i]);
+    } else if (arg == "--prefetch") {
+      options.PrefetchBatches = std::stoul(argv[++i]);
+    } else if (arg == "--epochs") {
+      options.Epochs = std::stoul(argv[++i]);
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  if (inputs.empty() != targets.empty()) {
+    std::cerr << "--inputs and --targets go together." << std::endl;
+    return 1;
+  }
+
+  std::filesystem::path synthetic;
+  std::vector<TrainingDataPipeline::ImagePair> pairs;
+  try {
+    if (inputs.empty()) {
+      synthetic =
+          std::filesystem::temp_directory_path() / "training_data_bench";
+      pairs = writeSyntheticPairs(synthetic);
+    } else {
+      pairs = TrainingDataPipeline::pairsFromGlobs(inputs, targets);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  // The network main.cpp builds, fed straight from the batches
+  Network network(nullptr, static_cast<int>(options.BatchSize));
+  LayerDense layer1(27, 9, ActivationMethod::Sigmoid);
+  LayerDense layer2(9, 6, ActivationMethod::ReLU);
+  LayerDense layer3(6, 3, ActivationMethod::Softmax);
+  network.AddLayer(&layer1);
+  network.AddLayer(&layer2);
+  network.AddLayer(&layer3);
+
+  double checksum = 0.0;
+  TrainingDataStats stats;
+  try {
+    TrainingDataPipeline pipeline(pairs, options);
+    TrainingBatch batch;
+    while (pipeline.next(batch)) {
+      if (forward) {
+        network.SetInputs(&batch.Inputs);
+        network.Forward();
+        checksum += (*network.outputs)(0, 0);
+      } else {
+        checksum += batch.Targets(0, 0);
+      }
+    }
+    stats = pipeline.stats();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  stats.print();
+  std::cout << "checksum " << checksum << std::endl;
+
+  if (!synthetic.empty()) std::filesystem::remove_all(synthetic);
+  return 0;
+}
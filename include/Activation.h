@@ -19,6 +19,8 @@ class Activation {
 
   // Forward pass - corrected the function name and added the return type
   Matrix forward(const Matrix& input);
+  // Applies the activation to values in place, without allocating
+  void apply(Matrix& values) const;
 
   // Getter - activation method
   ActivationMethod getActivationMethod() const { return m_activation; }
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap allocation tracking, opt-in because it replaces the global operator
+// new/delete for the whole program. Build with -DPROFILE_ALLOCATIONS=1 (`make
+// PROFILE_ALLOCATIONS=1`); otherwise every count below stays zero and scopes
+// don't touch the tracker.
+#ifndef PROFILE_ALLOCATIONS
+#define PROFILE_ALLOCATIONS 0
+#endif
+
+struct AllocationTotals {
+  uint64_t Count = 0;
+  uint64_t Bytes = 0;
+};
+
+// Allocations are attributed to the innermost PROFILE_SCOPE (or
+// PROFILE_FUNCTION) active on the allocating thread, by name ID.
+class AllocationTracker {
+ public:
+  static constexpr uint32_t kMaxScopes = 4096;
+  static constexpr uint32_t kNoScope = UINT32_MAX;
+
+  static constexpr bool enabled() { return PROFILE_ALLOCATIONS != 0; }
+
+  // Makes id the current scope and returns the one it replaces
+  static uint32_t enterScope(uint32_t id);
+  static void leaveScope(uint32_t previous);
+
+  // Called by the operator new replacements
+  static void recordAllocation(size_t bytes);
+
+  static AllocationTotals scopeTotals(uint32_t id);
+  static AllocationTotals unscopedTotals();
+  // Everything the calling thread has allocated so far
+  static AllocationTotals threadTotals();
+  static void reset();
+};
+
+// Counts the calling thread's allocations from construction onwards
+class AllocationCounter {
+ private:
+  AllocationTotals m_start;
+
+ public:
+  AllocationCounter() : m_start(AllocationTracker::threadTotals()) {}
+
+  uint64_t allocations() const {
+    return AllocationTracker::threadTotals().Count - m_start.Count;
+  }
+  uint64_t bytes() const {
+    return AllocationTracker::threadTotals().Bytes - m_start.Bytes;
+  }
+};
+
+// Aborts with a message if the enclosing scope allocates on this thread. Use
+// it (or ASSERT_NO_ALLOCATIONS) to pin down steady-state paths, e.g. a
+// Network::Forward after warm-up; tools/verify/ForwardAllocationCheck does
+// exactly that. Without PROFILE_ALLOCATIONS nothing is counted, so a guard
+// would always pass; it doesn't compile instead.
+class NoAllocationGuard {
+ private:
+  const char* m_name;
+  AllocationCounter m_counter;
+
+ public:
+  template <bool Enabled = AllocationTracker::enabled()>
+  explicit NoAllocationGuard(const char* name) : m_name(name) {
+    static_assert(Enabled,
+                  "NoAllocationGuard needs PROFILE_ALLOCATIONS=1; without it "
+                  "no allocation is counted");
+  }
+  ~NoAllocationGuard();
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Matrix.h"
+
+// Row-major matrix of 8-bit values. As a network input, a byte v stands for
+// the value v / 255.0, the same normalisation the image path applies.
+class ByteMatrix {
+ private:
+  std::vector<uint8_t> m_data;
+  size_t m_rows;
+  size_t m_cols;
+
+ public:
+  ByteMatrix(size_t rows, size_t cols)
+      : m_data(rows * cols), m_rows(rows), m_cols(cols) {}
+
+  // Accessors
+  size_t numRows() const { return m_rows; }
+  size_t numColumns() const { return m_cols; }
+  // Changes the shape, keeping the allocation when it is big enough. The
+  // contents are unspecified afterwards.
+  void resize(size_t rows, size_t cols) {
+    m_data.resize(rows * cols);
+    m_rows = rows;
+    m_cols = cols;
+  }
+
+  // Element access
+  uint8_t& operator()(size_t row, size_t col) {
+    return m_data[row * m_cols + col];
+  }
+  const uint8_t& operator()(size_t row, size_t col) const {
+    return m_data[row * m_cols + col];
+  }
+
+  // Converts network outputs in [0, 1] to bytes: v * 255 rounded to nearest
+  // and saturated to 0..255. Resizes to match values if needed.
+  void quantize(const Matrix& values);
+
+  // Getters
+  const uint8_t* data() const { return m_data.data(); }
+  uint8_t* data() { return m_data.data(); }
+};
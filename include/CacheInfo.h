@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+
+// Size in bytes of the calling CPU's data (or unified) cache at level 1, 2 or
+// 3, read once from sysfs, or 0 when it can't be found. Cores are assumed to
+// be alike, so this is cpu0's cache.
+size_t cacheSizeBytes(int level);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include <string>
+
+struct Frame {
+  size_t Index;
+  std::string Name;
+  cv::Mat Image;
+};
+
+struct PipelineStats {
+  size_t Frames = 0;
+  double WallSeconds = 0.0;
+  // Time each stage spent working, excluding time blocked on its queues
+  double DecodeSeconds = 0.0;
+  double InferSeconds = 0.0;
+  double EncodeSeconds = 0.0;
+
+  void print() const;
+};
+
+// Filters a frame sequence with decode, inference and encode running as
+// concurrent stages joined by bounded queues. Frames are filtered strictly in
+// order on a single inference thread, so stateful filters see consecutive
+// frames.
+//
+// The input is either a glob such as "frames/frame*.png" or a video file. The
+// output is a video file when it has a video extension (.avi, .mp4, .mkv,
+// .mov) and a directory of images otherwise.
+class FramePipeline {
+ public:
+  using Filter = std::function<cv::Mat(const cv::Mat&)>;
+
+  FramePipeline(Filter filter, size_t queueCapacity = 4);
+
+  PipelineStats run(const std::string& input, const std::string& output);
+
+ private:
+  Filter m_filter;
+  size_t m_queueCapacity;
+};
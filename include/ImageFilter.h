@@ -0,0 +1,62 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "NeighbourhoodCache.h"
+#include "Network.h"
+
+// Builds the 27-wide 3x3 neighbourhood rows for the interior pixels of row y.
+std::vector<std::vector<double>> processRow(const cv::Mat& in_img, int y);
+// Same, restricted to the pixels x_begin <= x < x_end of row y.
+std::vector<std::vector<double>> processRow(const cv::Mat& in_img, int y,
+                                            int x_begin, int x_end);
+
+// Copies the raw 27 bytes of the 3x3 neighbourhood around (x, y), in the
+// same order processRow uses.
+void gatherNeighbourhood(const cv::Mat& in_img, int y, int x, uint8_t* out);
+
+// processRow without the / 255.0: one row of raw neighbourhood bytes per
+// pixel, for the network's 8-bit input path.
+ByteMatrix processRowBytes(const cv::Mat& in_img, int y);
+ByteMatrix processRowBytes(const cv::Mat& in_img, int y, int x_begin,
+                           int x_end);
+
+// Runs one row of neighbourhoods through the network and converts the result
+// back to pixels.
+std::vector<cv::Vec3b> processRowPixels(
+    Network& network, const std::vector<std::vector<double>>& row_data);
+std::vector<cv::Vec3b> processRowPixels(Network& network,
+                                        const ByteMatrix& row_data);
+
+// Filters an already decoded image. The one-pixel border is left unset.
+// Throws std::invalid_argument if the network doesn't have 3 outputs.
+cv::Mat filterImage(Network& network, const cv::Mat& in_img);
+void processImage(Network& network, const std::string& input_filename,
+                  const std::string& output_filename);
+
+// Same filter as processImage for binary PPMs (P6) of any size. The image is
+// read, filtered and written band_rows rows at a time, keeping the two rows
+// the next band's 3x3 neighbourhoods need from the last read, so memory
+// depends on the width and band_rows but not the height. The border is
+// written black.
+void processImageStreaming(Network& network, const std::string& input_filename,
+                           const std::string& output_filename,
+                           int band_rows = 64);
+
+// Same filter as filterImage, but neighbourhoods already in the cache skip the
+// network. Misses from each row are batched together.
+cv::Mat filterImageCached(Network& network, NeighbourhoodCache& cache,
+                          const cv::Mat& in_img);
+void processImageCached(Network& network, NeighbourhoodCache& cache,
+                        const std::string& input_filename,
+                        const std::string& output_filename);
+
+// Same filter as filterImage, but the first layer runs as a convolution over
+// the whole image, so each byte is normalised once instead of once per window.
+cv::Mat filterImageConv(Network& network, LayerConv2D& conv,
+                        const cv::Mat& in_img);
+void processImageConv(Network& network, LayerConv2D& conv,
+                      const std::string& input_filename,
+                      const std::string& output_filename);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include "Network.h"
+
+struct IncrementalStats {
+  size_t Tiles = 0;
+  size_t DirtyTiles = 0;
+  size_t Pixels = 0;
+  size_t DirtyPixels = 0;
+  double Seconds = 0.0;
+  // Estimated time a full recompute would have taken, from the last frame
+  // that was computed in full
+  double FullFrameSeconds = 0.0;
+
+  double skippedFraction() const {
+    return Pixels > 0 ? 1.0 - static_cast<double>(DirtyPixels) / Pixels : 0.0;
+  }
+  double speedup() const {
+    return Seconds > 0.0 ? FullFrameSeconds / Seconds : 0.0;
+  }
+  void print() const;
+};
+
+// Filters consecutive frames of a sequence, recomputing only the tiles whose
+// input changed since the previous frame. An output pixel depends on its 3x3
+// neighbourhood, so a tile is compared against the previous input including a
+// one-pixel halo; clean tiles keep the previous output.
+class IncrementalFilter {
+ private:
+  Network& m_network;
+  int m_tileSize;
+  cv::Mat m_prevInput;
+  cv::Mat m_prevOutput;
+  double m_fullFrameSecondsPerPixel;
+  IncrementalStats m_lastStats;
+
+ public:
+  IncrementalFilter(Network& network, int tileSize = 32);
+
+  cv::Mat filter(const cv::Mat& in_img);
+
+  // Forgets the previous frame so the next one is computed in full
+  void reset();
+
+  void setTileSize(int tileSize);
+  int getTileSize() const { return m_tileSize; }
+  const IncrementalStats& lastStats() const { return m_lastStats; }
+
+ private:
+  bool tileChanged(const cv::Mat& in_img, int y0, int y1, int x0,
+                   int x1) const;
+  void computeTile(const cv::Mat& in_img, cv::Mat& out_img, int y0, int y1,
+                   int x0, int x1);
+};
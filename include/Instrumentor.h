@@ -1,112 +1,297 @@
+#pragma once
+
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <vector>
+
+#include "AllocationTracker.h"
+#include "LatencyHistogram.h"
+#include "PerfCounters.h"
+#include "TraceFormat.h"
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Declares a scope object of the given type, constructed from the name's
+// interned ID. The name is interned once per call site, so it must not change
+// between calls; string literals and the function-name macros are fine.
+#define PROFILE_OBJECT_ID(type, name, id)                           \
+  static const uint32_t PROFILE_CONCAT(profileId, id) =             \
+      Instrumentor::Get().InternName(name);                         \
+  type PROFILE_CONCAT(profileObject, id)(PROFILE_CONCAT(profileId, id))
+#define PROFILE_OBJECT(type, name) PROFILE_OBJECT_ID(type, name, __COUNTER__)
+
+// Aborts if the enclosing scope heap-allocates; see AllocationTracker.h
+#define ASSERT_NO_ALLOCATIONS(name) \
+  NoAllocationGuard PROFILE_CONCAT(noAllocationGuard, __COUNTER__)(name)
 
 #define PROFILING 1
 #if PROFILING
 #ifdef _MSC_VER  // Miscrosoft Compiler
-#define PROFILE_SCOPE(name) InstrumentationTimer timer##__LINE__(name)
-#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
-#define COUNT_FUNCTION() InstrumentationCounter counter##__LINE__(__FUNCTION__)
-#define TIME_FUNCTION() \
-  InstrumentationTimerAccumulator timerAccumulator##__LINE__(__FUNCTION__)
+#define PROFILE_FUNCTION_NAME __FUNCTION__
 #else  // Clang,  GCC
-#define PROFILE_SCOPE(name) InstrumentationTimer timer##__LINE__(name)
-#define PROFILE_FUNCTION() PROFILE_SCOPE(__PRETTY_FUNCTION__)
-#define COUNT_FUNCTION() \
-  InstrumentationCounter counter##__LINE__(__PRETTY_FUNCTION__)
-#define TIME_FUNCTION()                                       \
-  InstrumentationTimerAccumulator timerAccumulator##__LINE__( \
-      __PRETTY_FUNCTION__)
+#define PROFILE_FUNCTION_NAME __PRETTY_FUNCTION__
 #endif
+#define PROFILE_SCOPE(name) PROFILE_OBJECT(InstrumentationTimer, name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(PROFILE_FUNCTION_NAME)
+#define COUNT_FUNCTION() \
+  PROFILE_OBJECT(InstrumentationCounter, PROFILE_FUNCTION_NAME)
+#define TIME_FUNCTION() \
+  PROFILE_OBJECT(InstrumentationTimerAccumulator, PROFILE_FUNCTION_NAME)
+// Reads hardware performance counters around the scope. Each read is a
+// syscall, so keep these to coarse scopes such as a layer's forward pass.
+#define PROFILE_COUNTERS(name) PROFILE_OBJECT(InstrumentationPerfCounters, name)
 #else
 #define PROFILE_SCOPE(name)
 #define PROFILE_FUNCTION()
 #define COUNT_FUNCTION()
 #define TIME_FUNCTION()
+#define PROFILE_COUNTERS(name)
 #endif
 
 struct ProfileResult {
-  std::string Name;
+  uint32_t NameId;
+  uint32_t ThreadID;
   long long Start, End;
+};
+
+struct CounterResult {
+  uint32_t NameId;
   uint32_t ThreadID;
+  long long Start, End;
+  PerfSample Counters;
 };
 
 struct InstrumentCount {
-  long long Start;
-  long long Count;
+  std::atomic<long long> Start{0};
+  std::atomic<long long> Count{0};
 };
 
 struct InstrumentTime {
-  long long Start;
-  long long TotalTime;
+  std::atomic<long long> Start{0};
+  std::atomic<long long> TotalTime{0};
+  std::atomic<bool> Used{false};
+};
+
+struct InstrumentCounters {
+  long long Calls = 0;
+  PerfSample Total;
 };
 
 struct InstrumentationSession {
   std::string Name;
 };
 
+// Fixed-capacity single-producer/single-consumer ring of trace events. The
+// owning thread pushes without locking; the collector drains it. Events that
+// arrive while the ring is full are dropped and counted.
+class ProfileBuffer {
+ public:
+  static constexpr size_t kCapacity = 1 << 15;
+
+  bool push(const ProfileResult& result) {
+    size_t head = m_Head.load(std::memory_order_relaxed);
+    if (head - m_Tail.load(std::memory_order_acquire) == kCapacity) {
+      m_Dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    m_Events[head % kCapacity] = result;
+    m_Head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename Fn>
+  size_t drain(Fn&& fn) {
+    size_t tail = m_Tail.load(std::memory_order_relaxed);
+    size_t head = m_Head.load(std::memory_order_acquire);
+    for (size_t i = tail; i != head; i++) fn(m_Events[i % kCapacity]);
+    m_Tail.store(head, std::memory_order_release);
+    return head - tail;
+  }
+
+  size_t dropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+ private:
+  std::array<ProfileResult, kCapacity> m_Events;
+  alignas(64) std::atomic<size_t> m_Head{0};
+  alignas(64) std::atomic<size_t> m_Tail{0};
+  std::atomic<size_t> m_Dropped{0};
+};
+
+// Records scopes into per-thread rings. A collector thread drains them and
+// streams a binary log (see TraceFormat.h) to the session file; run
+// tools/TraceToJson on it to get Chrome tracing JSON.
 class Instrumentor {
+ public:
+  // Interned names beyond this share the last ID
+  static constexpr uint32_t kMaxNames = 4096;
+
+  // One thread's latency histograms, indexed by name ID and created the first
+  // time the thread records that ID
+  struct LatencyShard {
+    std::array<std::atomic<LatencyHistogram*>, kMaxNames> Histograms{};
+    ~LatencyShard();
+  };
+
  private:
   std::unique_ptr<InstrumentationSession> m_CurrentSession;
   std::ofstream m_OutputStream;
-  int m_ProfileCount;
-  std::unordered_map<std::string, InstrumentCount> m_FunctionCounts;
-  std::unordered_map<std::string, InstrumentTime> m_FunctionTimes;
+  std::atomic<bool> m_Active;
+  std::atomic<bool> m_CollectFunctionTimes;
+
+  // Name interning
+  std::mutex m_NamesMutex;
+  std::unordered_map<std::string, uint32_t> m_NameIds;
+  std::vector<std::string> m_Names;
+
+  // Indexed by name ID, updated with relaxed atomics
+  std::unique_ptr<InstrumentCount[]> m_FunctionCounts;
+  std::unique_ptr<InstrumentTime[]> m_FunctionTimes;
+
+  // One ring per recording thread, drained by the collector thread
+  std::mutex m_BuffersMutex;
+  std::vector<std::shared_ptr<ProfileBuffer>> m_Buffers;
+  std::thread m_Collector;
+  std::atomic<bool> m_StopCollector;
+
+  // Counter scopes already pay for two syscalls, so they share a lock
+  std::mutex m_CountersMutex;
+  std::vector<CounterResult> m_PendingCounters;
+  std::unordered_map<uint32_t, InstrumentCounters> m_CounterTotals;
+
+  // Per-thread TIME_FUNCTION histograms, merged when read
+  std::mutex m_LatencyMutex;
+  std::vector<std::shared_ptr<LatencyShard>> m_LatencyShards;
+
+  // Guards the output stream, its write buffer, the count of names already
+  // written and the events taken from the rings by the current drain
   std::mutex m_Mutex;
-  std::vector<ProfileResult> m_ProfileCache;
+  std::vector<char> m_WriteBuffer;
+  size_t m_NamesWritten;
+  std::vector<ProfileResult> m_Drained;
 
  public:
   Instrumentor();
   ~Instrumentor();
 
   void BeginSession(const std::string& name,
-                    const std::string& filepath = "results.json");
+                    const std::string& filepath = "results.trace");
   void EndSession();
-  void WriteProfile(const ProfileResult& result, bool force_write = false);
+  bool IsActive() const { return m_Active.load(std::memory_order_relaxed); }
+  // PROFILE_SCOPEs only time themselves while a session is open or while
+  // function times are being collected, which lets a benchmark read
+  // GetFunctionTime without writing a trace. Otherwise they cost a flag check.
+  void SetCollectFunctionTimes(bool collect) {
+    m_CollectFunctionTimes.store(collect, std::memory_order_relaxed);
+  }
+  bool IsTiming() const {
+    return IsActive() ||
+           m_CollectFunctionTimes.load(std::memory_order_relaxed);
+  }
   static Instrumentor& Get();
-  void IncrementFunctionCount(const std::string& name);
-  void AddFunctionTime(const std::string& name, long long time);
-  void AddFunctionTime(const std::string& name);
+
+  uint32_t InternName(const std::string& name);
+  std::string GetName(uint32_t id);
+
+  void WriteProfile(const ProfileResult& result);
+  void WriteCounters(const CounterResult& result);
+  void IncrementFunctionCount(uint32_t id);
+  void AddFunctionTime(uint32_t id, long long time);
+  void AddFunctionTime(uint32_t id);
+  // Microseconds spent in every PROFILE_SCOPE with this name so far, across
+  // threads, counting only the scopes that ran while IsTiming()
+  long long GetFunctionTime(uint32_t id) const {
+    return m_FunctionTimes[id].TotalTime.load(std::memory_order_relaxed);
+  }
+  void RecordLatency(uint32_t id, uint64_t nanoseconds);
+
+  // Merged TIME_FUNCTION latencies per scope, skipping empty ones. With reset
+  // the histograms start over, so periodic calls give interval statistics.
+  std::vector<std::pair<std::string, LatencySummary>> LatencySummaries(
+      bool reset = false);
+  void PrintLatencies(std::ostream& out, bool reset = false);
+  // Appends a timestamped report to the file; returns false if it can't be
+  // opened
+  bool DumpLatencies(const std::string& filepath, bool reset = true);
+
+  static long long NowMicros() {
+    return std::chrono::time_point_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now())
+        .time_since_epoch()
+        .count();
+  }
+  static uint32_t CurrentThreadID();
 
  private:
+  ProfileBuffer& ThreadBuffer();
+  LatencyShard& ThreadLatencyShard();
+  void CollectorLoop();
+  size_t DrainBuffers();
   void WriteHeader();
-  void WriteFooter();
-  void WriteCacheToFile();
-  void AddProfileToCache(const ProfileResult& result);
+  void WriteFooter(size_t dropped);
+  void WriteNewNames();
+  void PrintCounterSummary();
+  void PrintAllocationSummary();
+  void WriteRecord(const Trace::Record& record, const std::string& text = "");
+  void FlushWriteBuffer();
 };
 
 class InstrumentationTimer {
  public:
+  InstrumentationTimer(uint32_t nameId);
   InstrumentationTimer(const char* name);
   ~InstrumentationTimer();
 
   void Stop();
 
  private:
-  const char* m_Name;
+  uint32_t m_NameId;
+  uint32_t m_PreviousScope;  // restored for allocation tracking
   std::chrono::time_point<std::chrono::steady_clock> m_StartTimepoint;
+  bool m_Timing;  // IsTiming() when the scope opened
   bool m_Stopped;
 };
 
 class InstrumentationCounter {
  public:
-  InstrumentationCounter(const char* name) : m_Name(name) {
-    Instrumentor::Get().IncrementFunctionCount(m_Name);
+  InstrumentationCounter(uint32_t nameId) {
+    Instrumentor::Get().IncrementFunctionCount(nameId);
   }
+  InstrumentationCounter(const char* name)
+      : InstrumentationCounter(Instrumentor::Get().InternName(name)) {}
   ~InstrumentationCounter() {}
-
- private:
-  const char* m_Name;
 };
 
+// Marks where a function's accumulated runtime starts and records the
+// latency of each call into the function's histogram
 class InstrumentationTimerAccumulator {
  public:
+  InstrumentationTimerAccumulator(uint32_t nameId);
   InstrumentationTimerAccumulator(const char* name);
+  ~InstrumentationTimerAccumulator();
 
  private:
-  const char* m_Name;
-};
\ No newline at end of file
+  uint32_t m_NameId;
+  std::chrono::time_point<std::chrono::steady_clock> m_StartTimepoint;
+};
+
+class InstrumentationPerfCounters {
+ public:
+  InstrumentationPerfCounters(uint32_t nameId);
+  InstrumentationPerfCounters(const char* name);
+  ~InstrumentationPerfCounters();
+
+ private:
+  uint32_t m_NameId;
+  long long m_Start;
+  PerfSample m_StartCounters;
+};
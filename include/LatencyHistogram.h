@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+// Log-linear latency histogram in the style of HdrHistogram. Each power of two
+// is split into kSubBuckets linear buckets, so a recorded value is known to
+// within 1/kSubBuckets (about 3%) of itself at any magnitude.
+//
+// A histogram is written by one thread and may be read or reset by others:
+// every field is a relaxed atomic, and readers see each bucket exactly but not
+// necessarily the whole histogram at one instant.
+class LatencyHistogram {
+ public:
+  static constexpr unsigned kSubBucketBits = 5;
+  static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBucketBits;
+  static constexpr size_t kBucketCount =
+      (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  static size_t bucketIndex(uint64_t value) {
+    if (value < 2 * kSubBuckets) return static_cast<size_t>(value);
+    unsigned exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+    unsigned shift = exponent - kSubBucketBits;
+    return (shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets);
+  }
+
+  // Smallest value that falls in the bucket
+  static uint64_t bucketLowest(size_t index) {
+    if (index < 2 * kSubBuckets) return index;
+    size_t shift = index / kSubBuckets - 1;
+    return (kSubBuckets + index % kSubBuckets) << shift;
+  }
+
+  static uint64_t bucketWidth(size_t index) {
+    return index < 2 * kSubBuckets ? 1 : uint64_t{1} << (index / kSubBuckets - 1);
+  }
+
+  void record(uint64_t value) {
+    m_Counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_Sum.fetch_add(value, std::memory_order_relaxed);
+    if (value < m_Min.load(std::memory_order_relaxed)) {
+      m_Min.store(value, std::memory_order_relaxed);
+    }
+    if (value > m_Max.load(std::memory_order_relaxed)) {
+      m_Max.store(value, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  friend class LatencySnapshot;
+
+  std::array<std::atomic<uint64_t>, kBucketCount> m_Counts{};
+  std::atomic<uint64_t> m_Sum{0};
+  std::atomic<uint64_t> m_Min{std::numeric_limits<uint64_t>::max()};
+  std::atomic<uint64_t> m_Max{0};
+};
+
+struct LatencySummary {
+  uint64_t Count = 0;
+  uint64_t Min = 0, P50 = 0, P90 = 0, P99 = 0, P999 = 0, Max = 0;
+  double Mean = 0.0;
+
+  // One line of nanosecond values, shown in microseconds
+  void print(std::ostream& out) const;
+};
+
+// Plain copy of one or more histograms (e.g. every thread's shard for a scope)
+class LatencySnapshot {
+ private:
+  std::array<uint64_t, LatencyHistogram::kBucketCount> m_Counts{};
+  uint64_t m_Count = 0;
+  uint64_t m_Sum = 0;
+  uint64_t m_Min = std::numeric_limits<uint64_t>::max();
+  uint64_t m_Max = 0;
+
+ public:
+  // Adds the histogram's counts. With reset, they are moved out of it instead,
+  // so no sample recorded concurrently is counted twice or lost.
+  void merge(LatencyHistogram& histogram, bool reset);
+
+  uint64_t count() const { return m_Count; }
+  // Value at quantile q in [0, 1], accurate to the bucket width
+  uint64_t percentile(double q) const;
+  LatencySummary summary() const;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <fstream>
+
+#include "ByteMatrix.h"
+#include "Matrix.h"
+
+// Common interface for everything a Network can hold. Every layer consumes a
+// Matrix with one row per sample (or per pixel) and leaves its result in
+// `output`, which is owned by the layer.
+class Layer {
+ public:
+  Matrix* output = nullptr;
+
+  virtual ~Layer();
+
+  // Forward pass
+  virtual void forward(const Matrix& input) = 0;
+  // Forward pass over 8-bit inputs. The default converts to doubles with the
+  // usual / 255.0 and calls forward(const Matrix&).
+  virtual void forward(const ByteMatrix& input);
+  // Forward pass over rows x cols row-major values the layer doesn't own, such
+  // as one micro-batch of a larger input, read where they are. The defaults
+  // copy them into a Matrix (or ByteMatrix) and call the overloads above.
+  virtual void forwardRows(const double* input, size_t rows, size_t cols);
+  virtual void forwardRows(const uint8_t* input, size_t rows, size_t cols);
+
+  // Save/Load
+  virtual void save(std::ofstream& file) const = 0;
+  virtual void load(std::ifstream& file) = 0;
+
+  // Getters
+  virtual void print() const = 0;
+};
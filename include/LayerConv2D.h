@@ -0,0 +1,61 @@
+#pragma once
+
+#include <fstream>
+
+#include "Activation.h"
+#include "Layer.h"
+
+class LayerDense;
+
+// 2D convolution over an HWC image tensor.
+//
+// Inputs are a Matrix(height * width, inChannels) with one row per pixel in
+// row-major order, which is the memory layout of an interleaved image. The
+// output uses the same layout, so a LayerDense placed after this layer acts as
+// a per-pixel MLP.
+//
+// Weights hold one row per kernel tap and one column per output channel. Taps
+// are ordered column by column across the window (kx, then channel, then ky),
+// the same order processRow uses to build its 27-wide neighbourhoods, so a
+// dense layer trained on those rows converts without reshuffling.
+class LayerConv2D : public Layer {
+ private:
+  size_t m_inChannels;
+  size_t m_outChannels;
+  size_t m_kernelSize;
+  size_t m_stride;
+  size_t m_padding;
+  size_t m_inputHeight;
+  size_t m_inputWidth;
+  Matrix m_weights;
+  Matrix m_biases;
+  Activation m_activation;
+
+ public:
+  // Constructor
+  LayerConv2D(size_t inChannels, size_t outChannels, size_t kernelSize,
+              size_t stride, size_t padding, ActivationMethod activation);
+
+  // Converts a dense layer over processRow-style neighbourhoods (kernelSize^2
+  // * inChannels inputs) into the equivalent stride 1, unpadded convolution.
+  // The output matches the dense layer bit for bit.
+  LayerConv2D(const LayerDense& dense, size_t inChannels, size_t kernelSize);
+
+  // Forward pass
+  using Layer::forward;
+  void forward(const Matrix& input) override;
+
+  // Save/Load
+  void save(std::ofstream& file) const override;
+  void load(std::ifstream& file) override;
+
+  // Setters
+  void setInputSize(size_t height, size_t width);
+  void setWeights(const Matrix& weights);
+  void setBiases(const Matrix& biases);
+
+  // Getters
+  size_t outputHeight() const;
+  size_t outputWidth() const;
+  void print() const override;
+};
@@ -1,28 +1,47 @@
 #pragma once
 
 #include <fstream>
+#include <vector>
 
 #include "Activation.h"
+#include "Layer.h"
 
-class LayerDense {
+class LayerDense : public Layer {
  private:
   Matrix m_weights;
   Matrix m_biases;
   Activation m_activation;
+  // 8-bit inputs have the / 255.0 folded in ahead of time. Small layers use a
+  // lookup table where entry [(k * 256 + v) * outputs + n] holds
+  // (v / 255.0) * weights(k, n); larger ones use weights pre-divided by 255.
+  std::vector<double> m_lookupTable;
+  Matrix m_byteWeights;
+  // Bytes widened for the m_byteWeights path, kept between calls
+  Matrix m_converted;
+
+  void prepareByteInputs();
+  // Checks the input width and shapes `output` for rows rows
+  void resizeOutput(size_t rows, size_t cols);
 
  public:
-  Matrix* output = nullptr;
+  // Layers whose lookup table would exceed this size use the GEMM path for
+  // 8-bit inputs too
+  static constexpr size_t kMaxLookupTableBytes = 2 << 20;
 
   // Constructor
   LayerDense(size_t inputSize, size_t outputSize, ActivationMethod activation);
-  ~LayerDense();
 
   // Forward pass
-  void forward(const Matrix& input);
+  void forward(const Matrix& input) override;
+  // With a lookup table this is one gather-add per input instead of a
+  // conversion and a multiply-add per weight, identical to the GEMM path.
+  void forward(const ByteMatrix& input) override;
+  void forwardRows(const double* input, size_t rows, size_t cols) override;
+  void forwardRows(const uint8_t* input, size_t rows, size_t cols) override;
 
   // Save/Load
-  void save(std::ofstream& file) const;
-  void load(std::ifstream& file);
+  void save(std::ofstream& file) const override;
+  void load(std::ifstream& file) override;
 
   // Setters
   void setWeights(const Matrix& weights);
@@ -31,5 +50,11 @@ class LayerDense {
   void setOutput(Matrix* output);
 
   // Getters
-  void print() const;
+  const Matrix& getWeights() const { return m_weights; }
+  const Matrix& getBiases() const { return m_biases; }
+  bool hasLookupTable() const { return !m_lookupTable.empty(); }
+  ActivationMethod getActivation() const {
+    return m_activation.getActivationMethod();
+  }
+  void print() const override;
 };
\ No newline at end of file
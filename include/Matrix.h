@@ -1,13 +1,39 @@
 #pragma once
 
+#include <concepts>
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
 #include <vector>
 
+// Types that can stand on either side of the lazily evaluated Matrix
+// operators. Expressions hold references to their operands, so they are
+// meant to be consumed in the statement that builds them: assign them to a
+// Matrix, don't keep them in an auto variable.
+template <typename E>
+struct IsMatrixExpression : std::false_type {};
+
+template <typename E>
+concept MatrixExpression = IsMatrixExpression<E>::value;
+
+class Matrix;
+
+template <>
+struct IsMatrixExpression<Matrix> : std::true_type {};
+
+template <typename E>
+concept LazyMatrixExpression =
+    MatrixExpression<E> && !std::same_as<E, Matrix>;
+
 class Matrix {
  private:
   std::vector<double> m_data;
   size_t m_rows;
   size_t m_cols;
 
+  template <typename E>
+  void evaluate(const E& expr);
+
  public:
   // Constructors
   Matrix(size_t rows, size_t cols);
@@ -15,11 +41,23 @@ class Matrix {
   Matrix(const std::initializer_list<double>& values);
   Matrix(const std::vector<std::vector<double>>& values);
   Matrix(const std::initializer_list<std::initializer_list<double>>& values);
+  // Evaluates an expression such as A * B + bias in one pass
+  template <LazyMatrixExpression E>
+  Matrix(const E& expr);
+
+  // Evaluates into the existing storage, which is only reallocated if it is
+  // too small. An expression that reads this matrix is evaluated into a
+  // temporary first.
+  template <LazyMatrixExpression E>
+  Matrix& operator=(const E& expr);
 
   // Accessors
   size_t numRows() const;
   size_t numColumns() const;
   void print() const;
+  // Changes the shape, keeping the allocation when it is big enough. The
+  // contents are unspecified afterwards.
+  void resize(size_t rows, size_t cols);
 
   // Element access
   double& operator()(size_t col);
@@ -30,11 +68,250 @@ class Matrix {
   // operators
   static Matrix dotProduct(const Matrix& lhs, const Matrix& rhs);
   static Matrix add(const Matrix& lhs, const Matrix& rhs);
-  Matrix operator+(const Matrix& rhs) const;
-  Matrix operator*(const Matrix& rhs) const;
   Matrix transpose() const;
+  // In place; rhs may be a single row, which is added to every row
+  template <MatrixExpression E>
+  Matrix& operator+=(const E& rhs);
+  Matrix& operator*=(double alpha);
+
+  // In-place primitives, BLAS style. Only gemm with beta != 0 allocates: a
+  // per-thread scratch row, the first time and whenever c gets wider.
+  // c = alpha * a * b + beta * c. c must already be a.numRows() x
+  // b.numColumns() and must not be a or b; with beta == 0 it is only written.
+  static void gemm(double alpha, const Matrix& a, const Matrix& b, double beta,
+                   Matrix& c);
+  // y += alpha * x
+  static void axpy(double alpha, const Matrix& x, Matrix& y);
+  // x *= alpha
+  static void scale(double alpha, Matrix& x);
+  // Adds the 1 x c.numColumns() row to every row of c
+  static void addRowBroadcast(const Matrix& row, Matrix& c);
 
   // Getters
   const double* data() const;
   double* data();
 };
+
+// Expression nodes. Each can write row i of its value into out (evalRow) or
+// add it to out (addRowTo), so assignment runs one loop nest per row with
+// nothing materialised but the destination. aliases() tells assignment when
+// an operand is the destination.
+
+// A Matrix operand
+struct MatrixRef {
+  const Matrix& m;
+
+  size_t numRows() const { return m.numRows(); }
+  size_t numColumns() const { return m.numColumns(); }
+  double operator()(size_t i, size_t j) const { return m(i, j); }
+  bool aliases(const Matrix& dest) const { return &m == &dest; }
+
+  void evalRow(size_t i, double* out) const {
+    const double* row = m.data() + i * m.numColumns();
+    for (size_t j = 0; j < m.numColumns(); ++j) out[j] = row[j];
+  }
+  void addRowTo(size_t i, double* out) const {
+    const double* row = m.data() + i * m.numColumns();
+    for (size_t j = 0; j < m.numColumns(); ++j) out[j] += row[j];
+  }
+};
+
+template <typename E>
+auto matrixOperand(const E& expr) {
+  if constexpr (std::same_as<E, Matrix>) {
+    return MatrixRef{expr};
+  } else {
+    return expr;
+  }
+}
+
+template <typename E>
+using MatrixOperand = decltype(matrixOperand(std::declval<E>()));
+
+// out[j] = sum over k of (alpha * a[k]) * b(k, j), added up for k in order
+// from 0.0 (the same sums Matrix::dotProduct always produced) but walking b by
+// rows with the partial sums held in locals: 16 columns at a time for wide
+// outputs, then 4 at a time in registers, then one by one
+inline void matrixRowProduct(const double* a, const Matrix& b, double alpha,
+                             double* out) {
+  const size_t inner = b.numRows();
+  const size_t cols = b.numColumns();
+  const double* b_data = b.data();
+  size_t j = 0;
+  for (; j + 16 <= cols; j += 16) {
+    double acc[16] = {};
+    for (size_t k = 0; k < inner; ++k) {
+      const double a_k = alpha * a[k];
+      const double* b_row = b_data + k * cols + j;
+      for (size_t c = 0; c < 16; ++c) acc[c] += a_k * b_row[c];
+    }
+    for (size_t c = 0; c < 16; ++c) out[j + c] = acc[c];
+  }
+  for (; j + 4 <= cols; j += 4) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    for (size_t k = 0; k < inner; ++k) {
+      const double a_k = alpha * a[k];
+      const double* b_row = b_data + k * cols + j;
+      s0 += a_k * b_row[0];
+      s1 += a_k * b_row[1];
+      s2 += a_k * b_row[2];
+      s3 += a_k * b_row[3];
+    }
+    out[j] = s0;
+    out[j + 1] = s1;
+    out[j + 2] = s2;
+    out[j + 3] = s3;
+  }
+  for (; j < cols; ++j) {
+    double sum = 0.0;
+    for (size_t k = 0; k < inner; ++k) sum += alpha * a[k] * b_data[k * cols + j];
+    out[j] = sum;
+  }
+}
+
+// lhs * rhs
+struct MatrixProduct {
+  const Matrix& lhs;
+  const Matrix& rhs;
+
+  MatrixProduct(const Matrix& lhs, const Matrix& rhs);
+
+  size_t numRows() const { return lhs.numRows(); }
+  size_t numColumns() const { return rhs.numColumns(); }
+  double operator()(size_t i, size_t j) const {
+    double sum = 0.0;
+    for (size_t k = 0; k < lhs.numColumns(); ++k) sum += lhs(i, k) * rhs(k, j);
+    return sum;
+  }
+  bool aliases(const Matrix& dest) const {
+    return &lhs == &dest || &rhs == &dest;
+  }
+
+  void evalRow(size_t i, double* out) const {
+    matrixRowProduct(lhs.data() + i * lhs.numColumns(), rhs, 1.0, out);
+  }
+  void addRowTo(size_t i, double* out) const {
+    for (size_t j = 0; j < rhs.numColumns(); ++j) out[j] += (*this)(i, j);
+  }
+};
+
+// lhs + rhs, where rhs may be a single row added to every row of lhs
+template <typename L, typename R>
+struct MatrixSum {
+  L lhs;
+  R rhs;
+  bool broadcast;
+
+  MatrixSum(const L& lhs, const R& rhs);
+
+  size_t numRows() const { return lhs.numRows(); }
+  size_t numColumns() const { return lhs.numColumns(); }
+  double operator()(size_t i, size_t j) const {
+    return lhs(i, j) + rhs(broadcast ? 0 : i, j);
+  }
+  bool aliases(const Matrix& dest) const {
+    return lhs.aliases(dest) || rhs.aliases(dest);
+  }
+
+  void evalRow(size_t i, double* out) const {
+    lhs.evalRow(i, out);
+    rhs.addRowTo(broadcast ? 0 : i, out);
+  }
+  void addRowTo(size_t i, double* out) const {
+    for (size_t j = 0; j < numColumns(); ++j) out[j] += (*this)(i, j);
+  }
+};
+
+// alpha * expr
+template <typename E>
+struct MatrixScaled {
+  E expr;
+  double alpha;
+
+  size_t numRows() const { return expr.numRows(); }
+  size_t numColumns() const { return expr.numColumns(); }
+  double operator()(size_t i, size_t j) const { return alpha * expr(i, j); }
+  bool aliases(const Matrix& dest) const { return expr.aliases(dest); }
+
+  void evalRow(size_t i, double* out) const {
+    expr.evalRow(i, out);
+    for (size_t j = 0; j < numColumns(); ++j) out[j] *= alpha;
+  }
+  void addRowTo(size_t i, double* out) const {
+    for (size_t j = 0; j < numColumns(); ++j) out[j] += (*this)(i, j);
+  }
+};
+
+template <>
+struct IsMatrixExpression<MatrixProduct> : std::true_type {};
+template <typename L, typename R>
+struct IsMatrixExpression<MatrixSum<L, R>> : std::true_type {};
+template <typename E>
+struct IsMatrixExpression<MatrixScaled<E>> : std::true_type {};
+
+void checkMatrixSum(size_t lhsRows, size_t lhsCols, size_t rhsRows,
+                    size_t rhsCols);
+
+template <typename L, typename R>
+MatrixSum<L, R>::MatrixSum(const L& lhs, const R& rhs)
+    : lhs(lhs), rhs(rhs), broadcast(rhs.numRows() == 1) {
+  checkMatrixSum(lhs.numRows(), lhs.numColumns(), rhs.numRows(),
+                 rhs.numColumns());
+}
+
+// Products of expressions go through a temporary Matrix, since a product
+// reads each operand element many times
+inline MatrixProduct operator*(const Matrix& lhs, const Matrix& rhs) {
+  return MatrixProduct(lhs, rhs);
+}
+
+template <MatrixExpression L, MatrixExpression R>
+MatrixSum<MatrixOperand<L>, MatrixOperand<R>> operator+(const L& lhs,
+                                                        const R& rhs) {
+  return {matrixOperand(lhs), matrixOperand(rhs)};
+}
+
+template <MatrixExpression E>
+MatrixScaled<MatrixOperand<E>> operator*(double alpha, const E& expr) {
+  return {matrixOperand(expr), alpha};
+}
+
+template <MatrixExpression E>
+MatrixScaled<MatrixOperand<E>> operator*(const E& expr, double alpha) {
+  return {matrixOperand(expr), alpha};
+}
+
+template <typename E>
+void Matrix::evaluate(const E& expr) {
+  resize(expr.numRows(), expr.numColumns());
+  for (size_t i = 0; i < m_rows; ++i) expr.evalRow(i, data() + i * m_cols);
+}
+
+template <LazyMatrixExpression E>
+Matrix::Matrix(const E& expr) : m_rows(0), m_cols(0) {
+  evaluate(expr);
+}
+
+template <LazyMatrixExpression E>
+Matrix& Matrix::operator=(const E& expr) {
+  if (expr.aliases(*this)) {
+    *this = Matrix(expr);
+  } else {
+    evaluate(expr);
+  }
+  return *this;
+}
+
+template <MatrixExpression E>
+Matrix& Matrix::operator+=(const E& rhs) {
+  auto operand = matrixOperand(rhs);
+  checkMatrixSum(m_rows, m_cols, operand.numRows(), operand.numColumns());
+  if (operand.aliases(*this) && !std::same_as<E, Matrix>) {
+    return *this += Matrix(rhs);
+  }
+  const bool broadcast = operand.numRows() == 1;
+  for (size_t i = 0; i < m_rows; ++i) {
+    operand.addRowTo(broadcast ? 0 : i, data() + i * m_cols);
+  }
+  return *this;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct CacheStats {
+  size_t Lookups = 0;
+  size_t Hits = 0;
+  size_t Evictions = 0;
+  // Time spent in lookups/inserts and in running the network on misses
+  double CacheSeconds = 0.0;
+  double NetworkSeconds = 0.0;
+
+  double hitRate() const {
+    return Lookups > 0 ? static_cast<double>(Hits) / Lookups : 0.0;
+  }
+  // Estimated speedup over sending every neighbourhood to the network, using
+  // the measured per-miss network cost
+  double speedup() const;
+  void print() const;
+};
+
+// Memoises the filter output for raw 27-byte 3x3 neighbourhoods.
+//
+// A fixed-size open-addressing table: 32-byte entries, linear probing over at
+// most kMaxProbes slots, and the home slot is overwritten when every probed
+// slot is taken, so memory never grows past the size given at construction.
+// The cached network must not change while the cache is in use; call clear()
+// after loading new weights.
+class NeighbourhoodCache {
+ public:
+  static constexpr size_t kKeySize = 27;
+  static constexpr size_t kValueSize = 3;
+  static constexpr size_t kMaxProbes = 8;
+
+  // maxBytes is rounded down to a power-of-two number of entries
+  explicit NeighbourhoodCache(size_t maxBytes = 64 << 20);
+
+  // Copies the cached value into value and returns true on a hit
+  bool lookup(const uint8_t* key, uint8_t* value);
+  void insert(const uint8_t* key, const uint8_t* value);
+  void clear();
+
+  size_t capacity() const { return m_entries.size(); }
+  size_t sizeInBytes() const { return m_entries.size() * sizeof(Entry); }
+
+  CacheStats& stats() { return m_stats; }
+  const CacheStats& stats() const { return m_stats; }
+
+ private:
+  struct alignas(32) Entry {
+    uint8_t Key[kKeySize];
+    uint8_t Value[kValueSize];
+    uint8_t Used;
+  };
+
+  std::vector<Entry> m_entries;
+  size_t m_mask;
+  CacheStats m_stats;
+
+  static uint64_t hash(const uint8_t* key);
+};
@@ -1,20 +1,105 @@
 #pragma once
 
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "LayerConv2D.h"
 #include "LayerDense.h"
 
+// Inputs larger than one micro-batch are split and each micro-batch runs
+// through every layer before the next one starts, so a layer's output is
+// still in cache when the next layer reads it. A batchSize above 1 sets the
+// micro-batch rows; otherwise they are picked so the working set of the whole
+// layer stack fits in half of L2. Only networks made entirely of dense layers
+// are split: a convolution's rows are pixels of one image.
 class Network {
  private:
   Matrix* m_inputs;
-  std::vector<LayerDense*> m_layers;
+  std::vector<Layer*> m_layers;
   int m_batchSize;
+  // Stitched-together outputs when the input was split
+  Matrix m_outputs;
+
+  // Worker thread and queue behind ForwardAsync, started on first use
+  struct AsyncWorker;
+  std::unique_ptr<AsyncWorker> m_async;
+  std::mutex m_asyncMutex;
+
+  // Runs inputs through every layer (in micro-batches if needed) and returns
+  // the result, which the network or the last layer owns
+  template <typename Inputs>
+  Matrix* forwardLayers(const Inputs& inputs);
+  template <typename Element>
+  void forwardMicroBatches(const Element* inputs, size_t rows, size_t cols,
+                           size_t rowsPerBatch,
+                           const std::function<void(size_t, const Matrix&)>&
+                               callback);
+  AsyncWorker& asyncWorker();
 
  public:
+  // Used when sysfs doesn't report an L2 size
+  static constexpr size_t kDefaultL2Bytes = 256 << 10;
+  static constexpr size_t kMinMicroBatchRows = 64;
+  // Batches that can wait for the async worker; ForwardAsync blocks while all
+  // are taken. With the batch being run that makes three in flight, so the
+  // caller can pack one batch while two are queued or running.
+  static constexpr size_t kAsyncSlots = 2;
+
+  using ForwardCallback =
+      std::function<void(Matrix outputs, std::exception_ptr error)>;
+  // Receives rows [firstRow, firstRow + outputs.numRows()) of the network's
+  // outputs. outputs belongs to the last layer and is only valid during the
+  // call.
+  using RowsCallback =
+      std::function<void(size_t firstRow, const Matrix& outputs)>;
+
   Matrix* outputs;
 
   Network(Matrix* inputs, int batchSize);
-  void AddLayer(LayerDense* layer);
+  // Finishes any queued async batches first
+  ~Network();
+  void AddLayer(Layer* layer);
+  // Rows per micro-batch for the current layers, or 0 if inputs are never
+  // split
+  size_t MicroBatchRows() const;
   void Forward();
+  // Runs 8-bit inputs through the network. The first layer picks its fastest
+  // 8-bit kernel (a lookup table for small dense layers).
+  void Forward(const ByteMatrix& inputs);
+  // Same, also quantising the outputs (expected in [0, 1]) to bytes
+  void Forward(const ByteMatrix& inputs, ByteMatrix& byteOutputs);
+  // Runs rows x cols row-major inputs through the network a micro-batch at a
+  // time, reading them where they are, and hands each micro-batch's outputs
+  // to callback instead of collecting them; `outputs` is left alone. For
+  // inputs that already sit in a buffer, such as a mapped file, and outputs
+  // that are consumed as they come.
+  void ForwardRows(const double* inputs, size_t rows, size_t cols,
+                   const RowsCallback& callback);
+
+  // Queues inputs for an internal worker thread and returns the outputs
+  // through the future; `outputs` is left alone. Batches run in the order
+  // they were queued. Inputs are moved in and outputs moved out, so the
+  // caller can prepare the next batch while this one runs without copying
+  // either. The buffer the outputs came in is replaced by one given back
+  // through RecycleOutputs, or by a new one if there is none. Don't call
+  // Forward or change the layers while async batches are pending: they share
+  // the layers' buffers.
+  std::future<Matrix> ForwardAsync(Matrix inputs);
+  std::future<Matrix> ForwardAsync(ByteMatrix inputs);
+  // Same, but calls callback on the worker thread when the batch is done,
+  // with error set (and empty outputs) if the forward pass threw. The
+  // callback must not throw.
+  void ForwardAsync(Matrix inputs, ForwardCallback callback);
+  void ForwardAsync(ByteMatrix inputs, ForwardCallback callback);
+  // Returns async outputs the caller is done with, so later batches reuse
+  // their storage. Up to kAsyncSlots + 1 are kept, enough for every batch
+  // that can be in flight; any thread may call it, callbacks included.
+  void RecycleOutputs(Matrix outputs);
   void SetInputs(Matrix* inputs);
+  const std::vector<Layer*>& GetLayers() const { return m_layers; }
 
   void Save(std::ofstream& file) const;
   void Load(std::ifstream& file);
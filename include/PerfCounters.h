@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Hardware events read around PROFILE_COUNTERS scopes
+enum class PerfCounter : size_t {
+  Cycles,
+  Instructions,
+  L1DMisses,
+  LLCMisses,
+  BranchMisses,
+  Count
+};
+
+constexpr size_t kPerfCounterCount = static_cast<size_t>(PerfCounter::Count);
+
+const char* perfCounterName(PerfCounter counter);
+
+// One reading of the calling thread's counters. CpuTimeNs comes from the
+// thread CPU clock and is always present; a hardware value is only valid
+// when its bit is set in Available. EnabledNs and RunningNs are how long the
+// group has been enabled and how long it actually counted; they differ when
+// the kernel multiplexes it with other events.
+struct PerfSample {
+  std::array<uint64_t, kPerfCounterCount> Values{};
+  uint64_t CpuTimeNs = 0;
+  uint64_t EnabledNs = 0;
+  uint64_t RunningNs = 0;
+  uint32_t Available = 0;
+
+  bool has(PerfCounter counter) const {
+    return Available & (1u << static_cast<size_t>(counter));
+  }
+  uint64_t operator[](PerfCounter counter) const {
+    return Values[static_cast<size_t>(counter)];
+  }
+
+  // Counts between an earlier reading and this one, scaled up if the group
+  // only counted for part of that time and unavailable if it never did
+  PerfSample operator-(const PerfSample& start) const;
+};
+
+// Per-thread perf_event_open group counting user-space events on the calling
+// thread. When perf events aren't permitted (perf_event_paranoid, seccomp in
+// containers, non-Linux builds) readings only carry CpuTimeNs.
+class PerfCounterGroup {
+ private:
+  int m_leaderFd;
+  std::array<int, kPerfCounterCount> m_fds;
+  // Position of each opened counter in the group's read buffer
+  std::array<size_t, kPerfCounterCount> m_slots;
+  size_t m_opened;
+  uint32_t m_available;
+
+  PerfCounterGroup();
+
+ public:
+  ~PerfCounterGroup();
+  PerfCounterGroup(const PerfCounterGroup&) = delete;
+  PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+  // The calling thread's group, opened on first use
+  static PerfCounterGroup& forThread();
+
+  PerfSample read() const;
+  bool hasHardwareCounters() const { return m_available != 0; }
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <fstream>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+// Binary PPM (P6, maxval 255) read and written a few rows at a time, so an
+// image never has to be in memory at once. Rows are BGR in memory, like
+// cv::imread gives them; the file holds RGB.
+class PpmReader {
+ public:
+  // Reads the header. Throws std::invalid_argument if the file can't be
+  // opened or isn't an 8-bit binary PPM.
+  explicit PpmReader(const std::string& filename);
+
+  int rows() const { return m_rows; }
+  int cols() const { return m_cols; }
+  // Rows not read yet
+  int remaining() const { return m_rows - m_next; }
+
+  // Reads the next count rows into rows [first, first + count) of band, a
+  // CV_8UC3 Mat cols() wide. Throws std::invalid_argument if the file ends
+  // early.
+  void read(cv::Mat& band, int first, int count);
+
+ private:
+  std::ifstream m_file;
+  std::string m_filename;
+  int m_rows;
+  int m_cols;
+  int m_next;
+};
+
+class PpmWriter {
+ public:
+  // Writes the header for a rows x cols image. Throws std::invalid_argument
+  // if the file can't be opened.
+  PpmWriter(const std::string& filename, int rows, int cols);
+
+  // Appends rows [first, first + count) of band, a CV_8UC3 Mat cols wide.
+  // Throws std::invalid_argument if the write fails.
+  void write(const cv::Mat& band, int first, int count);
+
+ private:
+  std::ofstream m_file;
+  std::string m_filename;
+  int m_cols;
+  std::vector<uchar> m_row;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary trace log written by the Instrumentor and turned into Chrome
+// `traceEvents` JSON by tools/TraceToJson.
+//
+// A file is an 8-byte magic followed by a stream of fixed-size records in
+// host byte order. Session, Name, Counters and Allocations records are
+// followed by Length bytes of payload. A name is always defined before the
+// first record that uses its ID.
+namespace Trace {
+
+constexpr char kMagic[8] = {'C', 'N', 'N', 'T', 'R', 'C', '0', '1'};
+
+enum class RecordKind : uint32_t {
+  Session = 1,      // Length bytes of session name follow
+  Name = 2,         // NameId is defined as the Length bytes that follow
+  Event = 3,        // Scope on ThreadID from Start to Value (microseconds)
+  Count = 4,        // NameId was called Value times, first at Start
+  TotalTime = 5,    // NameId ran for Value microseconds in total, from Start
+  End = 6,          // Value events were dropped from full buffers
+  Counters = 7,     // PROFILE_COUNTERS scope, Start to Value; CounterPayload
+  Allocations = 8,  // Scope NameId's heap allocations; AllocationPayload
+};
+
+// Follows a Counters record. Hardware values are indexed by PerfCounter and
+// only meaningful when their bit is set in Available.
+struct CounterPayload {
+  uint64_t Available;
+  uint64_t CpuTimeNs;
+  uint64_t Values[5];
+};
+
+// Follows an Allocations record: the scope's totals for the session
+struct AllocationPayload {
+  uint64_t Count;
+  uint64_t Bytes;
+};
+
+struct Record {
+  RecordKind Kind;
+  uint32_t NameId;
+  uint32_t ThreadID;
+  uint32_t Length;
+  int64_t Start;
+  int64_t Value;
+};
+
+static_assert(sizeof(Record) == 32, "trace records must stay fixed-size");
+
+}  // namespace Trace
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "Matrix.h"
+
+// One mini-batch, ready for Network::SetInputs and Forward. Inputs holds one
+// 27-wide neighbourhood per row, normalised like processRow; Targets holds
+// the target image's pixel at the centre of each neighbourhood, / 255.0.
+struct TrainingBatch {
+  Matrix Inputs = Matrix(0, 27);
+  Matrix Targets = Matrix(0, 3);
+
+  size_t size() const { return Inputs.numRows(); }
+};
+
+struct TrainingDataStats {
+  size_t Images = 0;
+  size_t Samples = 0;
+  size_t Batches = 0;
+  double WallSeconds = 0.0;
+  // Time next() spent waiting for a batch
+  double StallSeconds = 0.0;
+  // Time the decode threads spent decoding and extracting, summed
+  double DecodeSeconds = 0.0;
+
+  void print() const;
+};
+
+struct TrainingDataOptions {
+  size_t BatchSize = 256;
+  // Samples held for shuffling. Larger mixes more images together.
+  size_t ShuffleBuffer = 1 << 16;
+  size_t DecodeThreads = 2;
+  // Batches prepared ahead of the consumer
+  size_t PrefetchBatches = 8;
+  size_t Epochs = 1;
+  unsigned Seed = 42;
+};
+
+// Streams (neighbourhood, target pixel) samples from pairs of input and target
+// images of the same size, one per interior pixel. Decode threads read and
+// unpack image pairs in a shuffled order, a batching thread mixes their
+// samples through a bounded shuffle buffer and the consumer pulls finished
+// batches with next(). Samples stay as bytes until they leave the shuffle
+// buffer, so it costs 30 bytes per sample.
+//
+// Memory is bounded by the shuffle buffer, PrefetchBatches batches and a few
+// decoded images. With more than one decode thread the order depends on
+// timing, so runs are only repeatable with DecodeThreads = 1.
+class TrainingDataPipeline {
+ public:
+  struct ImagePair {
+    std::string Input;
+    std::string Target;
+  };
+
+  TrainingDataPipeline(std::vector<ImagePair> pairs,
+                       const TrainingDataOptions& options = {});
+  ~TrainingDataPipeline();
+
+  TrainingDataPipeline(const TrainingDataPipeline&) = delete;
+  TrainingDataPipeline& operator=(const TrainingDataPipeline&) = delete;
+
+  // Moves the next batch into batch. The last batch of the run may be short.
+  // Returns false once every epoch has been delivered, and rethrows anything
+  // the background threads threw.
+  bool next(TrainingBatch& batch);
+
+  TrainingDataStats stats() const;
+
+  // Pairs the files matching two globs in sorted order
+  static std::vector<ImagePair> pairsFromGlobs(const std::string& inputs,
+                                               const std::string& targets);
+
+ private:
+  struct Sample {
+    uint8_t Inputs[27];
+    uint8_t Target[3];
+  };
+
+  std::vector<ImagePair> m_pairs;
+  TrainingDataOptions m_options;
+
+  BoundedQueue<std::vector<Sample>> m_samples;
+  BoundedQueue<TrainingBatch> m_batches;
+  std::vector<std::thread> m_decoders;
+  std::thread m_batcher;
+
+  std::vector<size_t> m_order;  // pair index for each (epoch, image) step
+  std::atomic<size_t> m_nextImage;
+  std::atomic<size_t> m_activeDecoders;
+  std::atomic<size_t> m_images;
+  std::atomic<int64_t> m_decodeNanoseconds;
+
+  std::chrono::steady_clock::time_point m_start;
+  size_t m_samplesDelivered;
+  size_t m_batchesDelivered;
+  double m_stallSeconds;
+
+  std::exception_ptr m_error;
+  std::mutex m_errorMutex;
+
+  void decode();
+  void shuffle();
+  void fail(std::exception_ptr error);
+  static void extract(const cv::Mat& input, const cv::Mat& target,
+                      std::vector<Sample>& samples);
+};
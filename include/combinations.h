@@ -1,47 +1,305 @@
 #ifndef COMBINATIONS_H
 #define COMBINATIONS_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
+// Enumerates every length-k string over letters (with repetition) in
+// lexicographic order of letter positions, i.e. counting in base
+// letters.size(). The n-th combination is n written in that base, so rank and
+// unrank are O(k) and the space splits into contiguous ranges.
 class CombinationsGenerator {
  private:
   const std::vector<char>& letters;
   int k;
   std::vector<int> indices;
-  bool hasNextCombination;
+  std::vector<char> current;  // letters at indices
+  uint64_t position;
+  uint64_t end;
+  uint64_t total;  // size(), or the largest uint64_t if that overflows
+  std::array<int, 256> letterIndex;
+
+  // Steps indices/current to the next combination, touching only the
+  // positions that change
+  void increment() {
+    const int base = static_cast<int>(letters.size());
+    for (int i = k - 1; i >= 0; i--) {
+      if (++indices[i] < base) {
+        current[i] = letters[indices[i]];
+        return;
+      }
+      indices[i] = 0;
+      current[i] = letters[0];
+    }
+  }
 
  public:
   CombinationsGenerator(const std::vector<char>& letters, int k)
-      : letters(letters), k(k), hasNextCombination(true) {
-    indices.reserve(k);
-    for (int i = 0; i < k; ++i) indices.push_back(0);
+      : letters(letters), k(k), indices(k, 0), position(0) {
+    if (k < 0) {
+      throw std::invalid_argument("Combination length must not be negative.");
+    }
+    if (letters.empty() && k > 0) {
+      throw std::invalid_argument("Combinations need at least one letter.");
+    }
+
+    letterIndex.fill(-1);
+    for (size_t i = 0; i < letters.size(); i++) {
+      letterIndex[static_cast<unsigned char>(letters[i])] = static_cast<int>(i);
+    }
+
+    // Spaces too large to count are enumerated as far as 64 bits go
+    total = std::numeric_limits<uint64_t>::max();
+    try {
+      total = size();
+    } catch (const std::overflow_error&) {
+    }
+    end = total;
+    current.assign(k, k > 0 ? letters[0] : '\0');
   }
 
-  std::string getNextCombination() {
-    std::string combination = "";
+  // letters.size() ^ k; throws if that doesn't fit in 64 bits
+  uint64_t size() const {
+    uint64_t total = 1;
     for (int i = 0; i < k; i++) {
-      combination += letters.at(indices.at(i));
+      if (total > std::numeric_limits<uint64_t>::max() / letters.size()) {
+        throw std::overflow_error("Too many combinations to count in 64 bits.");
+      }
+      total *= letters.size();
     }
+    return total;
+  }
+
+  int length() const { return k; }
 
-    // increment the indices
+  // Writes the k letters of combination n to out
+  void unrank(uint64_t n, char* out) const {
+    const uint64_t base = letters.size();
     for (int i = k - 1; i >= 0; i--) {
-      indices.at(i)++;
-      if (indices.at(i) == letters.size()) {
-        indices.at(i) = 0;
-        if (i == 0) {
-          hasNextCombination = false;
-          break;
-        }
-      } else {
-        break;
+      out[i] = letters[n % base];
+      n /= base;
+    }
+  }
+
+  std::string unrank(uint64_t n) const {
+    std::string combination(k, '\0');
+    unrank(n, combination.data());
+    return combination;
+  }
+
+  // Position of the combination in the enumeration order
+  uint64_t rank(const std::string& combination) const {
+    if (combination.size() != static_cast<size_t>(k)) {
+      throw std::invalid_argument("Combination has the wrong length.");
+    }
+    uint64_t n = 0;
+    for (char c : combination) {
+      int index = letterIndex[static_cast<unsigned char>(c)];
+      if (index < 0) {
+        throw std::invalid_argument("Combination uses an unknown letter.");
       }
+      n = n * letters.size() + index;
+    }
+    return n;
+  }
+
+  // Restricts the generator to combinations [begin, end_), starting at begin
+  void setRange(uint64_t begin, uint64_t end_) {
+    if (begin > end_ || end_ > total) {
+      throw std::out_of_range("Combination range is out of bounds.");
+    }
+    position = begin;
+    end = end_;
+    if (begin == end_) return;
+
+    const uint64_t base = letters.size();
+    for (int i = k - 1; i >= 0; i--) {
+      indices[i] = static_cast<int>(begin % base);
+      current[i] = letters[indices[i]];
+      begin /= base;
     }
+  }
 
+  std::string getNextCombination() {
+    std::string combination(current.begin(), current.end());
+    position++;
+    if (position < end) increment();
     return combination;
   }
 
-  bool hasMoreCombinations() const { return hasNextCombination; }
+  // Writes up to count combinations of length() letters each, back to back,
+  // into buffer and returns how many were written. Doesn't allocate.
+  size_t nextBatch(char* buffer, size_t count) {
+    size_t written = static_cast<size_t>(
+        std::min<uint64_t>(count, end - position));
+    const char* source = current.data();
+    for (size_t n = 0; n < written; n++, buffer += k) {
+      // A plain loop: k is small, and a memcpy call per combination costs
+      // more than the copy
+      for (int i = 0; i < k; i++) buffer[i] = source[i];
+      if (++position < end) increment();
+    }
+    return written;
+  }
+
+  bool hasMoreCombinations() const { return position < end; }
+};
+
+struct CombinationStats {
+  uint64_t Combinations = 0;
+  double Seconds = 0.0;
+
+  double rate() const { return Seconds > 0 ? Combinations / Seconds : 0.0; }
+  void print() const {
+    std::cout << Combinations << " combinations in " << Seconds << " s, "
+              << rate() / 1e6 << " M combinations/s" << std::endl;
+  }
 };
 
-#endif  // COMBINATIONS_H
\ No newline at end of file
+// Worker threads kept alive between forEachCombinationParallel calls, so
+// repeated enumerations don't pay for starting and joining threads
+class CombinationThreadPool {
+ private:
+  std::vector<std::thread> workers;
+  std::mutex runMutex;  // one run at a time
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  const std::function<void()>* task = nullptr;
+  uint64_t generation = 0;
+  size_t pending = 0;
+  bool stopping = false;
+
+  void workerLoop() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) return;
+      seen = generation;
+      const std::function<void()>* current = task;
+      lock.unlock();
+      (*current)();
+      lock.lock();
+      if (--pending == 0) done.notify_one();
+    }
+  }
+
+ public:
+  // threads == 0 uses every hardware thread
+  explicit CombinationThreadPool(unsigned threads = 0) {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+      workers.emplace_back(&CombinationThreadPool::workerLoop, this);
+    }
+  }
+
+  ~CombinationThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+  }
+
+  CombinationThreadPool(const CombinationThreadPool&) = delete;
+  CombinationThreadPool& operator=(const CombinationThreadPool&) = delete;
+
+  unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+  // Runs work once on every worker and waits for all of them. work must not
+  // throw.
+  void runOnEach(const std::function<void()>& work) {
+    std::lock_guard<std::mutex> run(runMutex);
+    std::unique_lock<std::mutex> lock(mutex);
+    task = &work;
+    pending = workers.size();
+    generation++;
+    wake.notify_all();
+    done.wait(lock, [&] { return pending == 0; });
+    task = nullptr;
+  }
+};
+
+// Enumerates every combination on the pool's workers. Workers claim chunks of
+// chunkSize consecutive ranks and call visitor(batch, count, k) for batches of
+// up to batchSize combinations laid out as in nextBatch. The visitor runs
+// concurrently on several threads. An exception from it stops every worker
+// and is rethrown here.
+template <typename Visitor>
+CombinationStats forEachCombinationParallel(const std::vector<char>& letters,
+                                            int k, Visitor&& visitor,
+                                            CombinationThreadPool& pool,
+                                            size_t batchSize = 4096,
+                                            uint64_t chunkSize = 1 << 20) {
+  batchSize = std::max<size_t>(batchSize, 1);
+  chunkSize = std::max<uint64_t>(chunkSize, batchSize);
+
+  const uint64_t total = CombinationsGenerator(letters, k).size();
+  std::atomic<uint64_t> next{0};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  std::mutex errorMutex;
+
+  const std::function<void()> worker = [&] {
+    try {
+      CombinationsGenerator generator(letters, k);
+      std::vector<char> buffer(batchSize * std::max(k, 1));
+      while (!failed.load(std::memory_order_relaxed)) {
+        uint64_t begin = next.fetch_add(chunkSize);
+        if (begin >= total) break;
+        generator.setRange(begin, std::min(total, begin + chunkSize));
+        while (size_t count = generator.nextBatch(buffer.data(), batchSize)) {
+          visitor(static_cast<const char*>(buffer.data()), count, k);
+        }
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (!error) error = std::current_exception();
+      failed = true;
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  pool.runOnEach(worker);
+
+  if (error) std::rethrow_exception(error);
+
+  CombinationStats stats;
+  stats.Combinations = total;
+  stats.Seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  return stats;
+}
+
+// One-off form: starts a pool of `threads` workers (0 = every hardware
+// thread) for this call only. Keep a CombinationThreadPool for repeated runs.
+template <typename Visitor>
+CombinationStats forEachCombinationParallel(const std::vector<char>& letters,
+                                            int k, Visitor&& visitor,
+                                            unsigned threads = 0,
+                                            size_t batchSize = 4096,
+                                            uint64_t chunkSize = 1 << 20) {
+  CombinationThreadPool pool(threads);
+  return forEachCombinationParallel(letters, k, visitor, pool, batchSize,
+                                    chunkSize);
+}
+
+#endif  // COMBINATIONS_H
@@ -20,41 +20,46 @@ Matrix Activation::forward(const Matrix& inputs) {
     m_output = new Matrix(inputs.numRows(), inputs.numColumns());
   }
 
+  *m_output = inputs;
+  apply(*m_output);
+  return *m_output;
+}
+
+void Activation::apply(Matrix& values) const {
+  double* data = values.data();
+  const size_t rows = values.numRows();
+  const size_t cols = values.numColumns();
+
   switch (m_activation) {
     case ActivationMethod::ReLU:
-      for (size_t i = 0; i < inputs.numRows(); ++i) {
-        for (size_t j = 0; j < inputs.numColumns(); ++j) {
-          double value = inputs(i, j);
-          (*m_output)(i, j) = std::max(0.0, value);
-        }
+      for (size_t i = 0; i < rows * cols; ++i) {
+        data[i] = std::max(0.0, data[i]);
       }
       break;
 
     case ActivationMethod::Sigmoid:
-      for (size_t i = 0; i < inputs.numRows(); ++i) {
-        for (size_t j = 0; j < inputs.numColumns(); ++j) {
-          double value = inputs(i, j);
-          (*m_output)(i, j) = 1.0 / (1.0 + std::exp(-value));
-        }
+      for (size_t i = 0; i < rows * cols; ++i) {
+        data[i] = 1.0 / (1.0 + std::exp(-data[i]));
       }
       break;
 
     case ActivationMethod::Softmax:
-      for (size_t i = 0; i < inputs.numRows(); ++i) {
+      for (size_t i = 0; i < rows; ++i) {
+        double* row = data + i * cols;
         double maxVal = -std::numeric_limits<double>::infinity();
         double sumExp = 0.0;
         // Find the max value for numerical stability
-        for (size_t j = 0; j < inputs.numColumns(); ++j) {
-          maxVal = std::max(maxVal, inputs(i, j));
+        for (size_t j = 0; j < cols; ++j) {
+          maxVal = std::max(maxVal, row[j]);
         }
         // Compute the sum of exponentials with the max subtracted for stability
-        for (size_t j = 0; j < inputs.numColumns(); ++j) {
-          (*m_output)(i, j) = std::exp(inputs(i, j) - maxVal);
-          sumExp += (*m_output)(i, j);
+        for (size_t j = 0; j < cols; ++j) {
+          row[j] = std::exp(row[j] - maxVal);
+          sumExp += row[j];
         }
         // Normalize the row
-        for (size_t j = 0; j < inputs.numColumns(); ++j) {
-          (*m_output)(i, j) /= sumExp;
+        for (size_t j = 0; j < cols; ++j) {
+          row[j] /= sumExp;
         }
       }
       break;
@@ -62,8 +67,6 @@ Matrix Activation::forward(const Matrix& inputs) {
     default:
       throw std::invalid_argument("Unsupported activation method.");
   }
-
-  return *m_output;
 }
 
 ActivationMethod Activation::setActivationMethod(ActivationMethod activation) {
@@ -0,0 +1,108 @@
+#include "AllocationTracker.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Nothing here may allocate: it all runs inside operator new. The counters
+// are zero-initialised statics and the thread state is trivially
+// constructible, so neither needs dynamic initialisation.
+namespace {
+
+struct ScopeCounters {
+  std::atomic<uint64_t> Count;
+  std::atomic<uint64_t> Bytes;
+};
+
+ScopeCounters g_scopes[AllocationTracker::kMaxScopes];
+ScopeCounters g_unscoped;
+
+thread_local uint32_t t_scope = AllocationTracker::kNoScope;
+thread_local AllocationTotals t_totals;
+
+AllocationTotals load(const ScopeCounters& counters) {
+  return {counters.Count.load(std::memory_order_relaxed),
+          counters.Bytes.load(std::memory_order_relaxed)};
+}
+
+}  // namespace
+
+uint32_t AllocationTracker::enterScope(uint32_t id) {
+  uint32_t previous = t_scope;
+  t_scope = id;
+  return previous;
+}
+
+void AllocationTracker::leaveScope(uint32_t previous) { t_scope = previous; }
+
+void AllocationTracker::recordAllocation(size_t bytes) {
+  t_totals.Count++;
+  t_totals.Bytes += bytes;
+
+  ScopeCounters& counters =
+      t_scope < kMaxScopes ? g_scopes[t_scope] : g_unscoped;
+  counters.Count.fetch_add(1, std::memory_order_relaxed);
+  counters.Bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+AllocationTotals AllocationTracker::scopeTotals(uint32_t id) {
+  return id < kMaxScopes ? load(g_scopes[id]) : AllocationTotals();
+}
+
+AllocationTotals AllocationTracker::unscopedTotals() {
+  return load(g_unscoped);
+}
+
+AllocationTotals AllocationTracker::threadTotals() { return t_totals; }
+
+void AllocationTracker::reset() {
+  for (ScopeCounters& counters : g_scopes) {
+    counters.Count.store(0, std::memory_order_relaxed);
+    counters.Bytes.store(0, std::memory_order_relaxed);
+  }
+  g_unscoped.Count.store(0, std::memory_order_relaxed);
+  g_unscoped.Bytes.store(0, std::memory_order_relaxed);
+}
+
+NoAllocationGuard::~NoAllocationGuard() {
+  uint64_t allocations = m_counter.allocations();
+  if (allocations == 0) return;
+
+  // stdio rather than iostreams, which may allocate
+  std::fprintf(stderr, "%s made %llu allocations (%llu bytes)\n", m_name,
+               static_cast<unsigned long long>(allocations),
+               static_cast<unsigned long long>(m_counter.bytes()));
+  std::abort();
+}
+
+#if PROFILE_ALLOCATIONS
+// The library's array and nothrow forms forward to these. The sized deletes
+// are replaced as well so compilers don't warn about a mismatched pair.
+void* operator new(size_t size) {
+  AllocationTracker::recordAllocation(size);
+  if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  AllocationTracker::recordAllocation(size);
+  size_t align = static_cast<size_t>(alignment);
+  // aligned_alloc needs the size to be a multiple of the alignment
+  size_t rounded = (size + align - 1) / align * align;
+  if (void* ptr = std::aligned_alloc(align, rounded ? rounded : align)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+#endif
@@ -0,0 +1,17 @@
+#include "ByteMatrix.h"
+
+void ByteMatrix::quantize(const Matrix& values) {
+  resize(values.numRows(), values.numColumns());
+
+  // Branch-free so the compiler turns it into packed scale/min/max/convert
+  // instructions. The comparisons also map NaN to 0.
+  const double* in = values.data();
+  uint8_t* out = m_data.data();
+  const size_t count = m_rows * m_cols;
+  for (size_t i = 0; i < count; ++i) {
+    double v = in[i] * 255.0 + 0.5;
+    v = v > 0.0 ? v : 0.0;
+    v = v < 255.0 ? v : 255.0;
+    out[i] = static_cast<uint8_t>(static_cast<int32_t>(v));
+  }
+}
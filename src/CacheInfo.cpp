@@ -0,0 +1,59 @@
+#include "CacheInfo.h"
+
+#include <array>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Parses sysfs sizes such as "48K" or "32768K"
+size_t parseSize(const std::string& text) {
+  size_t value = 0, i = 0;
+  while (i < text.size() && text[i] >= '0' && text[i] <= '9') {
+    value = value * 10 + (text[i++] - '0');
+  }
+  if (i < text.size()) {
+    if (text[i] == 'K') value <<= 10;
+    if (text[i] == 'M') value <<= 20;
+    if (text[i] == 'G') value <<= 30;
+  }
+  return value;
+}
+
+size_t readCacheSize(int level) {
+  const std::string base = "/sys/devices/system/cpu/cpu0/cache/index";
+  for (int index = 0;; index++) {
+    std::ifstream level_file(base + std::to_string(index) + "/level");
+    if (!level_file.is_open()) break;
+
+    int cache_level = 0;
+    std::string type, size;
+    level_file >> cache_level;
+    std::ifstream(base + std::to_string(index) + "/type") >> type;
+    std::ifstream(base + std::to_string(index) + "/size") >> size;
+    if (cache_level == level && type != "Instruction") return parseSize(size);
+  }
+
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_SIZE)
+  // Containers sometimes hide sysfs; glibc also asks cpuid
+  long size = level == 1   ? sysconf(_SC_LEVEL1_DCACHE_SIZE)
+              : level == 2 ? sysconf(_SC_LEVEL2_CACHE_SIZE)
+              : level == 3 ? sysconf(_SC_LEVEL3_CACHE_SIZE)
+                           : 0;
+  if (size > 0) return static_cast<size_t>(size);
+#endif
+  return 0;
+}
+
+}  // namespace
+
+size_t cacheSizeBytes(int level) {
+  if (level < 1 || level > 3) return 0;
+  static const std::array<size_t, 3> sizes = {
+      readCacheSize(1), readCacheSize(2), readCacheSize(3)};
+  return sizes[level - 1];
+}
@@ -0,0 +1,191 @@
+#include "FramePipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool isGlob(const std::string& path) {
+  return path.find_first_of("*?[") != std::string::npos;
+}
+
+bool isVideoFile(const std::string& path) {
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos) return false;
+  std::string ext = path.substr(dot);
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext == ".avi" || ext == ".mp4" || ext == ".mkv" || ext == ".mov";
+}
+
+std::string baseName(const std::string& path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Closes every queue if a stage fails so the other stages stop waiting.
+struct StageError {
+  std::exception_ptr error;
+  std::mutex mutex;
+
+  void set(std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!error) error = e;
+  }
+};
+
+}  // namespace
+
+void PipelineStats::print() const {
+  double fps = WallSeconds > 0.0 ? Frames / WallSeconds : 0.0;
+  auto utilisation = [this](double busy) {
+    return WallSeconds > 0.0 ? 100.0 * busy / WallSeconds : 0.0;
+  };
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << Frames << " frames in " << WallSeconds << " s (" << fps
+            << " frames/s)" << std::endl;
+  std::cout << "  decode: " << DecodeSeconds << " s busy, "
+            << utilisation(DecodeSeconds) << "% utilisation" << std::endl;
+  std::cout << "  infer:  " << InferSeconds << " s busy, "
+            << utilisation(InferSeconds) << "% utilisation" << std::endl;
+  std::cout << "  encode: " << EncodeSeconds << " s busy, "
+            << utilisation(EncodeSeconds) << "% utilisation" << std::endl;
+  std::cout.unsetf(std::ios::fixed);
+}
+
+FramePipeline::FramePipeline(Filter filter, size_t queueCapacity)
+    : m_filter(std::move(filter)), m_queueCapacity(queueCapacity) {}
+
+PipelineStats FramePipeline::run(const std::string& input,
+                                 const std::string& output) {
+  std::vector<std::string> files;
+  cv::VideoCapture capture;
+  double fps = 25.0;
+
+  if (isGlob(input)) {
+    cv::glob(input, files, false);
+    std::sort(files.begin(), files.end());
+    if (files.empty()) {
+      throw std::invalid_argument("No frames match: " + input);
+    }
+  } else {
+    if (!capture.open(input) || !capture.isOpened()) {
+      throw std::invalid_argument("Failed to open video: " + input);
+    }
+    if (capture.get(cv::CAP_PROP_FPS) > 0.0) {
+      fps = capture.get(cv::CAP_PROP_FPS);
+    }
+  }
+
+  BoundedQueue<Frame> decoded(m_queueCapacity);
+  BoundedQueue<Frame> filtered(m_queueCapacity);
+  StageError stageError;
+  PipelineStats stats;
+
+  auto fail = [&](std::exception_ptr e) {
+    stageError.set(e);
+    decoded.close();
+    filtered.close();
+  };
+
+  Clock::time_point start = Clock::now();
+
+  std::thread decoder([&] {
+    try {
+      for (size_t i = 0;; i++) {
+        Clock::time_point busy = Clock::now();
+        Frame frame{i, "", cv::Mat()};
+        if (!files.empty()) {
+          if (i == files.size()) break;
+          frame.Name = baseName(files[i]);
+          frame.Image = cv::imread(files[i]);
+          if (frame.Image.empty()) {
+            std::cerr << "Failed to load image: " << files[i] << std::endl;
+            stats.DecodeSeconds += secondsSince(busy);
+            continue;
+          }
+        } else {
+          if (!capture.read(frame.Image) || frame.Image.empty()) break;
+          char name[32];
+          std::snprintf(name, sizeof(name), "frame%04zu.png", i);
+          frame.Name = name;
+        }
+        stats.DecodeSeconds += secondsSince(busy);
+
+        if (!decoded.push(std::move(frame))) break;
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    decoded.close();
+  });
+
+  std::thread inferrer([&] {
+    try {
+      Frame frame;
+      while (decoded.pop(frame)) {
+        Clock::time_point busy = Clock::now();
+        frame.Image = m_filter(frame.Image);
+        stats.InferSeconds += secondsSince(busy);
+
+        if (!filtered.push(std::move(frame))) break;
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    filtered.close();
+  });
+
+  std::thread encoder([&] {
+    try {
+      cv::VideoWriter writer;
+      Frame frame;
+      while (filtered.pop(frame)) {
+        Clock::time_point busy = Clock::now();
+        if (isVideoFile(output)) {
+          if (!writer.isOpened() &&
+              !writer.open(output, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'),
+                           fps, frame.Image.size())) {
+            throw std::invalid_argument("Failed to open video: " + output);
+          }
+          writer.write(frame.Image);
+        } else {
+          std::string path = output + "/" + frame.Name;
+          if (!cv::imwrite(path, frame.Image)) {
+            std::cerr << "Failed to write image: " << path << std::endl;
+            stats.EncodeSeconds += secondsSince(busy);
+            continue;
+          }
+        }
+        stats.Frames++;
+        stats.EncodeSeconds += secondsSince(busy);
+      }
+      writer.release();
+    } catch (...) {
+      fail(std::current_exception());
+    }
+  });
+
+  decoder.join();
+  inferrer.join();
+  encoder.join();
+  stats.WallSeconds = secondsSince(start);
+
+  if (stageError.error) std::rethrow_exception(stageError.error);
+  return stats;
+}
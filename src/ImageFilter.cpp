@@ -0,0 +1,307 @@
+#include "ImageFilter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "Instrumentor.h"
+#include "PpmStream.h"
+
+std::vector<std::vector<double>> processRow(const cv::Mat& in_img, int y) {
+  return processRow(in_img, y, 1, in_img.cols - 1);
+}
+
+std::vector<std::vector<double>> processRow(const cv::Mat& in_img, int y,
+                                            int x_begin, int x_end) {
+  std::vector<std::vector<double>> row_data;
+  row_data.reserve(x_end - x_begin);
+
+  for (int x = x_begin; x < x_end; x++) {
+    std::vector<double> neighborhood;
+    neighborhood.reserve(27);
+
+    const uchar* previous_row = in_img.ptr<uchar>(y - 1);
+    const uchar* current_row = in_img.ptr<uchar>(y);
+    const uchar* next_row = in_img.ptr<uchar>(y + 1);
+
+    for (int offset = -3; offset <= 3; offset += 3) {
+      for (int ch = 0; ch < 3; ch++) {
+        neighborhood.push_back(previous_row[3 * x + offset + ch] / 255.0);
+        neighborhood.push_back(current_row[3 * x + offset + ch] / 255.0);
+        neighborhood.push_back(next_row[3 * x + offset + ch] / 255.0);
+      }
+    }
+
+    row_data.push_back(std::move(neighborhood));
+  }
+
+  return row_data;
+}
+
+void gatherNeighbourhood(const cv::Mat& in_img, int y, int x, uint8_t* out) {
+  const uchar* previous_row = in_img.ptr<uchar>(y - 1);
+  const uchar* current_row = in_img.ptr<uchar>(y);
+  const uchar* next_row = in_img.ptr<uchar>(y + 1);
+
+  for (int offset = -3; offset <= 3; offset += 3) {
+    for (int ch = 0; ch < 3; ch++) {
+      *out++ = previous_row[3 * x + offset + ch];
+      *out++ = current_row[3 * x + offset + ch];
+      *out++ = next_row[3 * x + offset + ch];
+    }
+  }
+}
+
+ByteMatrix processRowBytes(const cv::Mat& in_img, int y) {
+  return processRowBytes(in_img, y, 1, in_img.cols - 1);
+}
+
+ByteMatrix processRowBytes(const cv::Mat& in_img, int y, int x_begin,
+                           int x_end) {
+  ByteMatrix row_data(x_end - x_begin, 27);
+  for (int x = x_begin; x < x_end; x++) {
+    gatherNeighbourhood(in_img, y, x, &row_data(x - x_begin, 0));
+  }
+  return row_data;
+}
+
+static std::vector<cv::Vec3b> outputPixels(const ByteMatrix& output) {
+  std::vector<cv::Vec3b> out_pixel_row(output.numRows());
+  std::memcpy(out_pixel_row.data(), output.data(), 3 * output.numRows());
+  return out_pixel_row;
+}
+
+std::vector<cv::Vec3b> processRowPixels(
+    Network& network, const std::vector<std::vector<double>>& row_data) {
+  Matrix input(row_data);
+
+  network.SetInputs(&input);
+  network.Forward();
+
+  ByteMatrix output(0, 0);
+  output.quantize(*network.outputs);
+  return outputPixels(output);
+}
+
+std::vector<cv::Vec3b> processRowPixels(Network& network,
+                                        const ByteMatrix& row_data) {
+  ByteMatrix output(0, 0);
+  network.Forward(row_data, output);
+  return outputPixels(output);
+}
+
+// Filters rows [y_begin, y_end) of in_img into the interior of the rows
+// y_begin - out_offset onwards of out_img. Bytes in, bytes out: the quantised
+// output row is already laid out as the row's interior pixels.
+static void filterRows(Network& network, const cv::Mat& in_img,
+                       cv::Mat& out_img, int y_begin, int y_end,
+                       int out_offset) {
+  ByteMatrix row_data(std::max(in_img.cols - 2, 0), 27);
+  ByteMatrix out_row(0, 0);
+
+  for (int y = y_begin; y < y_end; y++) {
+    {
+      PROFILE_SCOPE("filterImage pack");
+      for (int x = 1; x < in_img.cols - 1; x++) {
+        gatherNeighbourhood(in_img, y, x, &row_data(x - 1, 0));
+      }
+    }
+    {
+      PROFILE_SCOPE("filterImage infer");
+      network.Forward(row_data, out_row);
+    }
+    // The unpack copies whole pixels, so it needs one output per channel
+    if (y == y_begin && out_row.numColumns() != 3) {
+      throw std::invalid_argument(
+          "The network must have 3 outputs to filter an image.");
+    }
+    PROFILE_SCOPE("filterImage unpack");
+    std::memcpy(out_img.ptr<uchar>(y - out_offset) + 3, out_row.data(),
+                3 * out_row.numRows());
+  }
+}
+
+cv::Mat filterImage(Network& network, const cv::Mat& in_img) {
+  cv::Mat out_img = cv::Mat(in_img.rows, in_img.cols, in_img.type());
+  filterRows(network, in_img, out_img, 1, in_img.rows - 1, 0);
+  return out_img;
+}
+
+void processImage(Network& network, const std::string& input_filename,
+                  const std::string& output_filename) {
+  cv::Mat in_img;
+  {
+    PROFILE_SCOPE("processImage decode");
+    in_img = cv::imread(input_filename);
+  }
+  if (in_img.empty()) {
+    std::cerr << "Failed to load image: " << input_filename << std::endl;
+    return;
+  }
+
+  cv::Mat out_img = filterImage(network, in_img);
+  PROFILE_SCOPE("processImage encode");
+  cv::imwrite(output_filename, out_img);
+}
+
+void processImageStreaming(Network& network, const std::string& input_filename,
+                           const std::string& output_filename,
+                           int band_rows) {
+  try {
+    PpmReader reader(input_filename);
+    PpmWriter writer(output_filename, reader.rows(), reader.cols());
+    const int rows = reader.rows(), cols = reader.cols();
+    band_rows = std::max(band_rows, 1);
+
+    // Input rows y - 1 .. y + band_rows for output rows y .. y + band_rows - 1.
+    // The border columns of out_band are never written, so they stay black.
+    cv::Mat in_band(band_rows + 2, cols, CV_8UC3);
+    cv::Mat out_band(band_rows, cols, CV_8UC3);
+    for (int y = 0; y < band_rows; y++) {
+      std::memset(out_band.ptr<uchar>(y), 0, 3 * static_cast<size_t>(cols));
+    }
+
+    if (rows < 3 || cols < 3) {
+      for (int y = 0; y < rows; y++) writer.write(out_band, 0, 1);
+      return;
+    }
+
+    // Top border row
+    writer.write(out_band, 0, 1);
+
+    int filled = std::min(band_rows + 2, rows);
+    {
+      PROFILE_SCOPE("processImageStreaming read");
+      reader.read(in_band, 0, filled);
+    }
+    for (;;) {
+      filterRows(network, in_band, out_band, 1, filled - 1, 1);
+      {
+        PROFILE_SCOPE("processImageStreaming write");
+        writer.write(out_band, 0, filled - 2);
+      }
+      if (reader.remaining() == 0) break;
+
+      // The last two rows are the halo above the next band
+      std::memcpy(in_band.ptr<uchar>(0), in_band.ptr<uchar>(filled - 2),
+                  3 * static_cast<size_t>(cols));
+      std::memcpy(in_band.ptr<uchar>(1), in_band.ptr<uchar>(filled - 1),
+                  3 * static_cast<size_t>(cols));
+      int next = std::min(band_rows, reader.remaining());
+      PROFILE_SCOPE("processImageStreaming read");
+      reader.read(in_band, 2, next);
+      filled = next + 2;
+    }
+
+    // Bottom border row
+    std::memset(out_band.ptr<uchar>(0), 0, 3 * static_cast<size_t>(cols));
+    writer.write(out_band, 0, 1);
+  } catch (const std::invalid_argument& e) {
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+cv::Mat filterImageCached(Network& network, NeighbourhoodCache& cache,
+                          const cv::Mat& in_img) {
+  using Clock = std::chrono::steady_clock;
+  CacheStats& stats = cache.stats();
+
+  cv::Mat out_img = cv::Mat(in_img.rows, in_img.cols, in_img.type());
+  const int width = in_img.cols - 2;
+
+  std::vector<int> miss_x;
+  miss_x.reserve(width);
+
+  for (int y = 1; y < in_img.rows - 1; y++) {
+    Clock::time_point start = Clock::now();
+    ByteMatrix keys = processRowBytes(in_img, y);
+    cv::Vec3b* out_row = out_img.ptr<cv::Vec3b>(y);
+
+    miss_x.clear();
+    for (int x = 1; x < in_img.cols - 1; x++) {
+      if (!cache.lookup(&keys(x - 1, 0), &out_row[x][0])) {
+        miss_x.push_back(x);
+      }
+    }
+
+    if (miss_x.empty()) {
+      stats.CacheSeconds +=
+          std::chrono::duration<double>(Clock::now() - start).count();
+      continue;
+    }
+
+    // Only the misses go to the network, as one compacted batch
+    ByteMatrix misses(miss_x.size(), NeighbourhoodCache::kKeySize);
+    for (size_t i = 0; i < miss_x.size(); i++) {
+      std::memcpy(&misses(i, 0), &keys(miss_x[i] - 1, 0),
+                  NeighbourhoodCache::kKeySize);
+    }
+    Clock::time_point lookedUp = Clock::now();
+
+    std::vector<cv::Vec3b> out_pixels = processRowPixels(network, misses);
+    Clock::time_point inferred = Clock::now();
+
+    for (size_t i = 0; i < miss_x.size(); i++) {
+      out_row[miss_x[i]] = out_pixels[i];
+      cache.insert(&misses(i, 0), &out_pixels[i][0]);
+    }
+
+    stats.CacheSeconds +=
+        std::chrono::duration<double>(lookedUp - start).count() +
+        std::chrono::duration<double>(Clock::now() - inferred).count();
+    stats.NetworkSeconds +=
+        std::chrono::duration<double>(inferred - lookedUp).count();
+  }
+
+  return out_img;
+}
+
+void processImageCached(Network& network, NeighbourhoodCache& cache,
+                        const std::string& input_filename,
+                        const std::string& output_filename) {
+  cv::Mat in_img = cv::imread(input_filename);
+  if (in_img.empty()) {
+    std::cerr << "Failed to load image: " << input_filename << std::endl;
+    return;
+  }
+
+  cv::imwrite(output_filename, filterImageCached(network, cache, in_img));
+}
+
+cv::Mat filterImageConv(Network& network, LayerConv2D& conv,
+                        const cv::Mat& in_img) {
+  // The HWC tensor is the image itself, one row per pixel
+  ByteMatrix input(static_cast<size_t>(in_img.rows) * in_img.cols, 3);
+  for (int y = 0; y < in_img.rows; y++) {
+    std::memcpy(&input(static_cast<size_t>(y) * in_img.cols, 0),
+                in_img.ptr<uchar>(y), 3 * in_img.cols);
+  }
+
+  conv.setInputSize(in_img.rows, in_img.cols);
+  ByteMatrix output(0, 0);
+  network.Forward(input, output);
+
+  cv::Mat out_img = cv::Mat(in_img.rows, in_img.cols, in_img.type());
+  size_t out_cols = conv.outputWidth();
+
+  for (int y = 1; y < in_img.rows - 1; y++) {
+    std::memcpy(out_img.ptr<uchar>(y) + 3, &output((y - 1) * out_cols, 0),
+                3 * out_cols);
+  }
+
+  return out_img;
+}
+
+void processImageConv(Network& network, LayerConv2D& conv,
+                      const std::string& input_filename,
+                      const std::string& output_filename) {
+  cv::Mat in_img = cv::imread(input_filename);
+  if (in_img.empty()) {
+    std::cerr << "Failed to load image: " << input_filename << std::endl;
+    return;
+  }
+
+  cv::imwrite(output_filename, filterImageConv(network, conv, in_img));
+}
@@ -0,0 +1,115 @@
+#include "IncrementalFilter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "ImageFilter.h"
+
+void IncrementalStats::print() const {
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << DirtyTiles << "/" << Tiles << " tiles recomputed, "
+            << 100.0 * skippedFraction() << "% of pixels skipped, "
+            << std::setprecision(2) << speedup() << "x speedup" << std::endl;
+  std::cout.unsetf(std::ios::fixed);
+}
+
+IncrementalFilter::IncrementalFilter(Network& network, int tileSize)
+    : m_network(network), m_fullFrameSecondsPerPixel(0.0) {
+  setTileSize(tileSize);
+}
+
+void IncrementalFilter::setTileSize(int tileSize) {
+  if (tileSize < 1) {
+    throw std::invalid_argument("Tile size must be at least 1.");
+  }
+  m_tileSize = tileSize;
+}
+
+void IncrementalFilter::reset() {
+  m_prevInput = cv::Mat();
+  m_prevOutput = cv::Mat();
+}
+
+cv::Mat IncrementalFilter::filter(const cv::Mat& in_img) {
+  auto start = std::chrono::steady_clock::now();
+
+  bool full = m_prevInput.empty() || m_prevInput.rows != in_img.rows ||
+              m_prevInput.cols != in_img.cols ||
+              m_prevInput.type() != in_img.type();
+
+  // The previous output may still be referenced by the caller, so work on a
+  // copy rather than updating it in place
+  cv::Mat out_img = full ? cv::Mat(in_img.rows, in_img.cols, in_img.type())
+                         : m_prevOutput.clone();
+
+  m_lastStats = IncrementalStats();
+  for (int y0 = 1; y0 < in_img.rows - 1; y0 += m_tileSize) {
+    int y1 = std::min(y0 + m_tileSize, in_img.rows - 1);
+    for (int x0 = 1; x0 < in_img.cols - 1; x0 += m_tileSize) {
+      int x1 = std::min(x0 + m_tileSize, in_img.cols - 1);
+      size_t pixels = static_cast<size_t>(y1 - y0) * (x1 - x0);
+
+      m_lastStats.Tiles++;
+      m_lastStats.Pixels += pixels;
+      if (full || tileChanged(in_img, y0, y1, x0, x1)) {
+        computeTile(in_img, out_img, y0, y1, x0, x1);
+        m_lastStats.DirtyTiles++;
+        m_lastStats.DirtyPixels += pixels;
+      }
+    }
+  }
+
+  m_prevInput = in_img.clone();
+  m_prevOutput = out_img;
+
+  m_lastStats.Seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  if (full && m_lastStats.Pixels > 0) {
+    m_fullFrameSecondsPerPixel = m_lastStats.Seconds / m_lastStats.Pixels;
+  }
+  m_lastStats.FullFrameSeconds =
+      m_fullFrameSecondsPerPixel * m_lastStats.Pixels;
+
+  return out_img;
+}
+
+bool IncrementalFilter::tileChanged(const cv::Mat& in_img, int y0, int y1,
+                                    int x0, int x1) const {
+  // Include the one-pixel halo the 3x3 neighbourhoods read
+  size_t offset = static_cast<size_t>(x0 - 1) * in_img.elemSize();
+  size_t length = static_cast<size_t>(x1 - x0 + 2) * in_img.elemSize();
+
+  for (int y = y0 - 1; y <= y1; y++) {
+    if (std::memcmp(in_img.ptr<uchar>(y) + offset,
+                    m_prevInput.ptr<uchar>(y) + offset, length) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void IncrementalFilter::computeTile(const cv::Mat& in_img, cv::Mat& out_img,
+                                    int y0, int y1, int x0, int x1) {
+  // Run the whole tile through the network as one batch
+  ByteMatrix tile_data(static_cast<size_t>(y1 - y0) * (x1 - x0), 27);
+  size_t row = 0;
+  for (int y = y0; y < y1; y++) {
+    for (int x = x0; x < x1; x++) {
+      gatherNeighbourhood(in_img, y, x, &tile_data(row++, 0));
+    }
+  }
+
+  std::vector<cv::Vec3b> out_pixels = processRowPixels(m_network, tile_data);
+
+  size_t i = 0;
+  for (int y = y0; y < y1; y++) {
+    for (int x = x0; x < x1; x++) {
+      out_img.at<cv::Vec3b>(y, x) = out_pixels[i++];
+    }
+  }
+}
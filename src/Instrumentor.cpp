@@ -1,115 +1,415 @@
 #include "Instrumentor.h"
 
+#include <cstring>
+#include <iomanip>
 #include <iostream>
-#include <mutex>
 
-std::mutex mtx;
-
-Instrumentor::Instrumentor() : m_CurrentSession(nullptr), m_ProfileCount(0){};
+namespace {
+// The collector hands this much data to the stream at a time
+constexpr size_t kWriteBufferBytes = 1 << 20;
+
+static_assert(sizeof(Trace::CounterPayload::Values) / sizeof(uint64_t) ==
+                  kPerfCounterCount,
+              "the trace payload must hold every PerfCounter");
+static_assert(AllocationTracker::kMaxScopes == Instrumentor::kMaxNames,
+              "allocation scopes are indexed by name ID");
+}  // namespace
+
+Instrumentor::Instrumentor()
+    : m_CurrentSession(nullptr),
+      m_Active(false),
+      m_CollectFunctionTimes(false),
+      m_FunctionCounts(new InstrumentCount[kMaxNames]),
+      m_FunctionTimes(new InstrumentTime[kMaxNames]),
+      m_StopCollector(false),
+      m_NamesWritten(0) {}
 
 Instrumentor::~Instrumentor() { EndSession(); }
 
 void Instrumentor::BeginSession(const std::string& name,
                                 const std::string& filepath) {
-  m_OutputStream.open(filepath);
+  // A session started over an open one finishes the open one first, since
+  // its collector is still running and its file still open
+  if (m_CurrentSession) EndSession();
+
+  m_OutputStream.open(filepath, std::ios::binary);
   if (!m_OutputStream.is_open()) {
     std::cerr << "Failed to open the file: " << filepath << std::endl;
     return;
   }
+  m_WriteBuffer.reserve(kWriteBufferBytes);
   m_CurrentSession = std::make_unique<InstrumentationSession>();
   m_CurrentSession->Name = name;
   WriteHeader();
+
+  // A scope that saw the last session still active can push after its final
+  // drain; whatever it left belongs to no session
+  {
+    std::lock_guard<std::mutex> lock(m_BuffersMutex);
+    for (const auto& buffer : m_Buffers) buffer->drain([](const auto&) {});
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_CountersMutex);
+    m_PendingCounters.clear();
+    m_CounterTotals.clear();
+  }
+
+  m_StopCollector = false;
+  m_Collector = std::thread(&Instrumentor::CollectorLoop, this);
+  m_Active = true;
 }
 
 void Instrumentor::EndSession() {
-  WriteCacheToFile();
-  WriteFooter();
+  if (!m_CurrentSession) return;
+
+  m_Active = false;
+  m_StopCollector = true;
+  if (m_Collector.joinable()) m_Collector.join();
+  DrainBuffers();
+
+  size_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_BuffersMutex);
+    for (const auto& buffer : m_Buffers) dropped += buffer->dropped();
+
+    // Buffers only referenced here belong to threads that have exited
+    m_Buffers.erase(std::remove_if(m_Buffers.begin(), m_Buffers.end(),
+                                   [](const auto& buffer) {
+                                     return buffer.use_count() == 1;
+                                   }),
+                    m_Buffers.end());
+  }
+  if (dropped > 0) {
+    std::cerr << "Instrumentor dropped " << dropped
+              << " events from full trace buffers" << std::endl;
+  }
+
+  WriteFooter(dropped);
+  PrintCounterSummary();
+  PrintLatencies(std::cout, true);
+  PrintAllocationSummary();
   std::lock_guard<std::mutex> lock(m_Mutex);
   m_OutputStream.close();
   m_CurrentSession = nullptr;
-  m_ProfileCount = 0;
-  m_FunctionCounts.clear();
+  m_NamesWritten = 0;
+  for (uint32_t id = 0; id < kMaxNames; id++) {
+    m_FunctionCounts[id].Start = 0;
+    m_FunctionCounts[id].Count = 0;
+    m_FunctionTimes[id].Start = 0;
+    m_FunctionTimes[id].TotalTime = 0;
+    m_FunctionTimes[id].Used = false;
+  }
+}
+
+uint32_t Instrumentor::InternName(const std::string& name) {
+  std::lock_guard<std::mutex> lock(m_NamesMutex);
+  auto it = m_NameIds.find(name);
+  if (it != m_NameIds.end()) return it->second;
+
+  if (m_Names.size() == kMaxNames - 1) {
+    m_Names.push_back("(other)");
+  }
+  if (m_Names.size() >= kMaxNames) return kMaxNames - 1;
+
+  uint32_t id = static_cast<uint32_t>(m_Names.size());
+  m_Names.push_back(name);
+  m_NameIds.emplace(name, id);
+  return id;
+}
+
+std::string Instrumentor::GetName(uint32_t id) {
+  std::lock_guard<std::mutex> lock(m_NamesMutex);
+  return id < m_Names.size() ? m_Names[id] : "(unknown)";
+}
+
+uint32_t Instrumentor::CurrentThreadID() {
+  thread_local uint32_t threadID = static_cast<uint32_t>(
+      std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  return threadID;
+}
+
+ProfileBuffer& Instrumentor::ThreadBuffer() {
+  // The buffer is shared with the collector so events recorded just before a
+  // thread exits are still written
+  thread_local std::shared_ptr<ProfileBuffer> buffer = [this] {
+    auto created = std::make_shared<ProfileBuffer>();
+    std::lock_guard<std::mutex> lock(m_BuffersMutex);
+    m_Buffers.push_back(created);
+    return created;
+  }();
+  return *buffer;
+}
+
+Instrumentor::LatencyShard::~LatencyShard() {
+  for (auto& histogram : Histograms) delete histogram.load();
+}
+
+Instrumentor::LatencyShard& Instrumentor::ThreadLatencyShard() {
+  // Kept alive by the instrumentor after the thread exits so its samples
+  // still show up in reports
+  thread_local std::shared_ptr<LatencyShard> shard = [this] {
+    auto created = std::make_shared<LatencyShard>();
+    std::lock_guard<std::mutex> lock(m_LatencyMutex);
+    m_LatencyShards.push_back(created);
+    return created;
+  }();
+  return *shard;
+}
+
+void Instrumentor::RecordLatency(uint32_t id, uint64_t nanoseconds) {
+  std::atomic<LatencyHistogram*>& slot = ThreadLatencyShard().Histograms[id];
+  LatencyHistogram* histogram = slot.load(std::memory_order_acquire);
+  if (!histogram) {
+    histogram = new LatencyHistogram();
+    slot.store(histogram, std::memory_order_release);
+  }
+  histogram->record(nanoseconds);
+}
+
+std::vector<std::pair<std::string, LatencySummary>>
+Instrumentor::LatencySummaries(bool reset) {
+  std::vector<std::shared_ptr<LatencyShard>> shards;
+  {
+    std::lock_guard<std::mutex> lock(m_LatencyMutex);
+    shards = m_LatencyShards;
+  }
+
+  std::vector<std::pair<std::string, LatencySummary>> summaries;
+  for (uint32_t id = 0; id < kMaxNames; id++) {
+    LatencySnapshot snapshot;
+    bool recorded = false;
+    for (const auto& shard : shards) {
+      LatencyHistogram* histogram =
+          shard->Histograms[id].load(std::memory_order_acquire);
+      if (!histogram) continue;
+      snapshot.merge(*histogram, reset);
+      recorded = true;
+    }
+    if (recorded && snapshot.count() > 0) {
+      summaries.emplace_back(GetName(id), snapshot.summary());
+    }
+  }
+  return summaries;
+}
+
+void Instrumentor::PrintLatencies(std::ostream& out, bool reset) {
+  auto summaries = LatencySummaries(reset);
+  if (summaries.empty()) return;
+
+  out << "Latencies:" << std::endl;
+  for (const auto& [name, summary] : summaries) {
+    out << "  " << name << ": ";
+    summary.print(out);
+    out << std::endl;
+  }
+}
+
+bool Instrumentor::DumpLatencies(const std::string& filepath, bool reset) {
+  std::ofstream file(filepath, std::ios::app);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open the file: " << filepath << std::endl;
+    return false;
+  }
+
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  file << "# " << now.count() << " ms since epoch" << std::endl;
+  PrintLatencies(file, reset);
+  return true;
+}
+
+void Instrumentor::WriteProfile(const ProfileResult& result) {
+  if (!IsActive()) return;
+  ThreadBuffer().push(result);
+}
+
+void Instrumentor::WriteCounters(const CounterResult& result) {
+  if (!IsActive()) return;
+
+  std::lock_guard<std::mutex> lock(m_CountersMutex);
+  m_PendingCounters.push_back(result);
+
+  InstrumentCounters& totals = m_CounterTotals[result.NameId];
+  totals.Total.Available = totals.Calls == 0
+                               ? result.Counters.Available
+                               : totals.Total.Available & result.Counters.Available;
+  for (size_t i = 0; i < kPerfCounterCount; i++) {
+    totals.Total.Values[i] += result.Counters.Values[i];
+  }
+  totals.Total.CpuTimeNs += result.Counters.CpuTimeNs;
+  totals.Calls++;
+}
+
+void Instrumentor::CollectorLoop() {
+  while (!m_StopCollector.load()) {
+    if (DrainBuffers() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  }
 }
 
-void Instrumentor::WriteProfile(const ProfileResult& result, bool force_write) {
-  if (force_write) {
-    AddProfileToCache(result);
-    WriteCacheToFile();
-  } else {
-    AddProfileToCache(result);
+size_t Instrumentor::DrainBuffers() {
+  std::vector<std::shared_ptr<ProfileBuffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(m_BuffersMutex);
+    buffers = m_Buffers;
   }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  // Take the events first and write the names after: every ID taken was
+  // interned before its event was pushed, so it is in the name table by now,
+  // while a name interned later can only belong to an event left for the
+  // next drain
+  m_Drained.clear();
+  for (const auto& buffer : buffers) {
+    buffer->drain(
+        [this](const ProfileResult& result) { m_Drained.push_back(result); });
+  }
+  std::vector<CounterResult> counters;
+  {
+    std::lock_guard<std::mutex> countersLock(m_CountersMutex);
+    counters.swap(m_PendingCounters);
+  }
+
+  WriteNewNames();
+
+  for (const CounterResult& result : counters) {
+    Trace::CounterPayload payload = {result.Counters.Available,
+                                     result.Counters.CpuTimeNs,
+                                     {}};
+    std::copy(result.Counters.Values.begin(), result.Counters.Values.end(),
+              payload.Values);
+    WriteRecord({Trace::RecordKind::Counters, result.NameId, result.ThreadID,
+                 sizeof(payload), result.Start, result.End},
+                std::string(reinterpret_cast<const char*>(&payload),
+                            sizeof(payload)));
+  }
+  for (const ProfileResult& result : m_Drained) {
+    WriteRecord({Trace::RecordKind::Event, result.NameId, result.ThreadID, 0,
+                 result.Start, result.End});
+  }
+  return counters.size() + m_Drained.size();
 }
 
 void Instrumentor::WriteHeader() {
   std::lock_guard<std::mutex> lock(m_Mutex);
-  m_OutputStream << "{\"session\": \"" << m_CurrentSession->Name << "\",";
-  m_OutputStream << "\"traceEvents\": [";
-  m_OutputStream.flush();
+  m_OutputStream.write(Trace::kMagic, sizeof(Trace::kMagic));
+  const std::string& name = m_CurrentSession->Name;
+  WriteRecord({Trace::RecordKind::Session, 0, 0,
+               static_cast<uint32_t>(name.size()), 0, 0},
+              name);
 }
 
-void Instrumentor::WriteFooter() {
+void Instrumentor::WriteFooter(size_t dropped) {
   std::lock_guard<std::mutex> lock(m_Mutex);
+  WriteNewNames();
 
-  for (auto it = m_FunctionCounts.begin(); it != m_FunctionCounts.end(); ++it) {
-    if (m_ProfileCount++ > 0) m_OutputStream << ",";
-    m_OutputStream << "{";
-    m_OutputStream << "\"cat\": \"Function Call Count\",";
-    m_OutputStream << "\"args\":{\"Count\":" << it->second.Count << "},";
-    m_OutputStream << "\"name\":\"_c " << it->first << "\",";
-    m_OutputStream << "\"ph\": \"C\",";
-    m_OutputStream << "\"pid\": 65536,";
-    m_OutputStream << "\"tid\": 0,";
-    m_OutputStream << "\"ts\":" << it->second.Start;
-    m_OutputStream << "}";
-  }
-
-  for (auto it = m_FunctionTimes.begin(); it != m_FunctionTimes.end(); ++it) {
-    if (m_ProfileCount++ > 0) m_OutputStream << ",";
-    m_OutputStream << "{";
-    m_OutputStream << "\"cat\": \"Function Total Runtime\",";
-    m_OutputStream << "\"dur\":" << it->second.TotalTime << ',';
-    m_OutputStream << "\"name\":\"_tr " << it->first << "\",";
-    m_OutputStream << "\"ph\": \"X\",";
-    m_OutputStream << "\"pid\": 0,";
-    m_OutputStream << "\"tid\": 1,";
-    m_OutputStream << "\"ts\":" << it->second.Start;
-    m_OutputStream << "}";
-  }
-
-  m_OutputStream << "]}";
-  m_OutputStream.flush();
-}
+  for (uint32_t id = 0; id < kMaxNames; id++) {
+    const InstrumentCount& count = m_FunctionCounts[id];
+    if (count.Count == 0) continue;
+    WriteRecord(
+        {Trace::RecordKind::Count, id, 0, 0, count.Start, count.Count});
+  }
 
-void Instrumentor::AddProfileToCache(const ProfileResult& result) {
-  m_ProfileCache.push_back(result);
-  if (m_ProfileCache.size() >= 10000) {
-    WriteCacheToFile();
+  for (uint32_t id = 0; id < kMaxNames; id++) {
+    const InstrumentTime& time = m_FunctionTimes[id];
+    if (!time.Used) continue;
+    WriteRecord({Trace::RecordKind::TotalTime, id, 0, 0, time.Start,
+                 time.TotalTime});
+  }
+
+  if (AllocationTracker::enabled()) {
+    for (uint32_t id = 0; id < kMaxNames; id++) {
+      AllocationTotals totals = AllocationTracker::scopeTotals(id);
+      if (totals.Count == 0) continue;
+      Trace::AllocationPayload payload = {totals.Count, totals.Bytes};
+      WriteRecord({Trace::RecordKind::Allocations, id, 0, sizeof(payload), 0,
+                   0},
+                  std::string(reinterpret_cast<const char*>(&payload),
+                              sizeof(payload)));
+    }
   }
+
+  WriteRecord({Trace::RecordKind::End, 0, 0, 0, 0,
+               static_cast<int64_t>(dropped)});
+  FlushWriteBuffer();
 }
 
-void Instrumentor::WriteCacheToFile() {
-  std::lock_guard<std::mutex> lock(m_Mutex);
+void Instrumentor::PrintCounterSummary() {
+  std::lock_guard<std::mutex> lock(m_CountersMutex);
+  if (m_CounterTotals.empty()) return;
 
-  for (const auto& result : m_ProfileCache) {
-    if (m_ProfileCount++ > 0) m_OutputStream << ",";
+  std::cout << "Counter scopes (misses per 1000 instructions):" << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+  for (const auto& [id, totals] : m_CounterTotals) {
+    const PerfSample& total = totals.Total;
+    std::cout << "  " << GetName(id) << ": " << totals.Calls << " calls, "
+              << total.CpuTimeNs / 1000.0 / totals.Calls << " us CPU/call";
+
+    if (!total.has(PerfCounter::Cycles)) {
+      std::cout << ", hardware counters unavailable" << std::endl;
+      continue;
+    }
+    if (total.has(PerfCounter::Instructions)) {
+      double instructions = static_cast<double>(total[PerfCounter::Instructions]);
+      std::cout << ", IPC "
+                << instructions / std::max<uint64_t>(total[PerfCounter::Cycles], 1);
+      for (PerfCounter counter :
+           {PerfCounter::L1DMisses, PerfCounter::LLCMisses,
+            PerfCounter::BranchMisses}) {
+        if (!total.has(counter)) continue;
+        std::cout << ", " << perfCounterName(counter) << " "
+                  << 1000.0 * total[counter] / std::max(instructions, 1.0);
+      }
+    }
+    std::cout << std::endl;
+  }
+  std::cout.unsetf(std::ios::fixed);
+  m_CounterTotals.clear();
+}
 
-    std::string name = result.Name;
-    std::replace(name.begin(), name.end(), '"', '\'');
+void Instrumentor::PrintAllocationSummary() {
+  if (!AllocationTracker::enabled()) return;
 
-    m_OutputStream << "{";
-    m_OutputStream << "\"cat\": \"Function Runtime\",";
-    m_OutputStream << "\"dur\":" << (result.End - result.Start) << ',';
-    m_OutputStream << "\"name\":\"" << name << "\",";
-    m_OutputStream << "\"ph\": \"X\",";
-    m_OutputStream << "\"pid\": 0,";
-    m_OutputStream << "\"tid\":" << result.ThreadID << ",";
-    m_OutputStream << "\"ts\":" << result.Start;
-    m_OutputStream << "}";
+  std::cout << "Allocations:" << std::endl;
+  for (uint32_t id = 0; id < kMaxNames; id++) {
+    AllocationTotals totals = AllocationTracker::scopeTotals(id);
+    if (totals.Count == 0) continue;
+    std::cout << "  " << GetName(id) << ": " << totals.Count
+              << " allocations, " << totals.Bytes << " bytes" << std::endl;
+  }
+  AllocationTotals unscoped = AllocationTracker::unscopedTotals();
+  std::cout << "  (outside scopes): " << unscoped.Count << " allocations, "
+            << unscoped.Bytes << " bytes" << std::endl;
+  AllocationTracker::reset();
+}
 
-    m_OutputStream.flush();
+void Instrumentor::WriteNewNames() {
+  std::lock_guard<std::mutex> lock(m_NamesMutex);
+  for (; m_NamesWritten < m_Names.size(); m_NamesWritten++) {
+    const std::string& name = m_Names[m_NamesWritten];
+    WriteRecord({Trace::RecordKind::Name,
+                 static_cast<uint32_t>(m_NamesWritten), 0,
+                 static_cast<uint32_t>(name.size()), 0, 0},
+                name);
   }
+}
+
+void Instrumentor::WriteRecord(const Trace::Record& record,
+                               const std::string& text) {
+  size_t offset = m_WriteBuffer.size();
+  m_WriteBuffer.resize(offset + sizeof(record) + text.size());
+  std::memcpy(m_WriteBuffer.data() + offset, &record, sizeof(record));
+  std::memcpy(m_WriteBuffer.data() + offset + sizeof(record), text.data(),
+              text.size());
 
-  m_ProfileCache.clear();
+  if (m_WriteBuffer.size() >= kWriteBufferBytes) FlushWriteBuffer();
+}
+
+void Instrumentor::FlushWriteBuffer() {
+  m_OutputStream.write(m_WriteBuffer.data(), m_WriteBuffer.size());
+  m_OutputStream.flush();
+  m_WriteBuffer.clear();
 }
 
 Instrumentor& Instrumentor::Get() {
@@ -117,70 +417,100 @@ Instrumentor& Instrumentor::Get() {
   return instance;
 }
 
-void Instrumentor::IncrementFunctionCount(const std::string& name) {
-  std::lock_guard<std::mutex> lock(m_Mutex);
-  m_FunctionCounts[name].Count++;
-
-  if (m_FunctionCounts[name].Count == 1) {
-    m_FunctionCounts[name].Start =
-        std::chrono::time_point_cast<std::chrono::microseconds>(
-            std::chrono::steady_clock::now())
-            .time_since_epoch()
-            .count();
+void Instrumentor::IncrementFunctionCount(uint32_t id) {
+  InstrumentCount& count = m_FunctionCounts[id];
+  if (count.Count.fetch_add(1, std::memory_order_relaxed) == 0) {
+    count.Start.store(NowMicros(), std::memory_order_relaxed);
   }
 }
 
-void Instrumentor::AddFunctionTime(const std::string& name, long long time) {
-  std::lock_guard<std::mutex> lock(m_Mutex);
+void Instrumentor::AddFunctionTime(uint32_t id, long long time) {
+  InstrumentTime& entry = m_FunctionTimes[id];
+  entry.TotalTime.fetch_add(time, std::memory_order_relaxed);
+  entry.Used.store(true, std::memory_order_relaxed);
+}
 
-  // if time is -1 and not in map, add it and set time to just now
-  // else increment time only
-  if (time == -1) {
-    if (m_FunctionTimes.find(name) == m_FunctionTimes.end()) {
-      m_FunctionTimes[name].TotalTime = 0;
-      m_FunctionTimes[name].Start =
-          std::chrono::time_point_cast<std::chrono::microseconds>(
-              std::chrono::steady_clock::now())
-              .time_since_epoch()
-              .count();
-    }
-  } else {
-    m_FunctionTimes[name].TotalTime += time;
+void Instrumentor::AddFunctionTime(uint32_t id) {
+  // Marks the start of the accumulated runtime the first time it is seen
+  InstrumentTime& entry = m_FunctionTimes[id];
+  long long unset = 0;
+  entry.Start.compare_exchange_strong(unset, NowMicros(),
+                                      std::memory_order_relaxed);
+  entry.Used.store(true, std::memory_order_relaxed);
+}
+
+InstrumentationTimer::InstrumentationTimer(uint32_t nameId)
+    : m_NameId(nameId), m_PreviousScope(AllocationTracker::kNoScope),
+      m_Timing(Instrumentor::Get().IsTiming()),
+      m_Stopped(false) {
+  if (AllocationTracker::enabled()) {
+    m_PreviousScope = AllocationTracker::enterScope(nameId);
   }
+  if (m_Timing) m_StartTimepoint = std::chrono::steady_clock::now();
 }
 
 InstrumentationTimer::InstrumentationTimer(const char* name)
-    : m_Name(name), m_Stopped(false) {
-  m_StartTimepoint = std::chrono::steady_clock::now();
-}
+    : InstrumentationTimer(Instrumentor::Get().InternName(name)) {}
 
 InstrumentationTimer::~InstrumentationTimer() {
   if (!m_Stopped) Stop();
 }
 
 void InstrumentationTimer::Stop() {
-  auto endTimepoint = std::chrono::steady_clock::now();
+  if (m_Timing) {
+    auto endTimepoint = std::chrono::steady_clock::now();
 
-  long long start =
-      std::chrono::time_point_cast<std::chrono::microseconds>(m_StartTimepoint)
-          .time_since_epoch()
-          .count();
+    long long start = std::chrono::time_point_cast<std::chrono::microseconds>(
+                          m_StartTimepoint)
+                          .time_since_epoch()
+                          .count();
 
-  long long end =
-      std::chrono::time_point_cast<std::chrono::microseconds>(endTimepoint)
-          .time_since_epoch()
-          .count();
-
-  uint32_t threadID = std::hash<std::thread::id>{}(std::this_thread::get_id());
-  Instrumentor::Get().WriteProfile({m_Name, start, end, threadID});
+    long long end =
+        std::chrono::time_point_cast<std::chrono::microseconds>(endTimepoint)
+            .time_since_epoch()
+            .count();
 
-  Instrumentor::Get().AddFunctionTime(m_Name, end - start);
+    Instrumentor& instrumentor = Instrumentor::Get();
+    instrumentor.WriteProfile(
+        {m_NameId, Instrumentor::CurrentThreadID(), start, end});
+    instrumentor.AddFunctionTime(m_NameId, end - start);
+  }
+  if (AllocationTracker::enabled()) {
+    AllocationTracker::leaveScope(m_PreviousScope);
+  }
 
   m_Stopped = true;
 }
 
+InstrumentationTimerAccumulator::InstrumentationTimerAccumulator(
+    uint32_t nameId)
+    : m_NameId(nameId) {
+  Instrumentor::Get().AddFunctionTime(nameId);
+  m_StartTimepoint = std::chrono::steady_clock::now();
+}
+
 InstrumentationTimerAccumulator::InstrumentationTimerAccumulator(
     const char* name)
-    : m_Name(name) {
-  Instrumentor::Get().AddFunctionTime(m_Name, -1);
-}
\ No newline at end of file
+    : InstrumentationTimerAccumulator(Instrumentor::Get().InternName(name)) {}
+
+InstrumentationPerfCounters::InstrumentationPerfCounters(uint32_t nameId)
+    : m_NameId(nameId), m_Start(Instrumentor::NowMicros()) {
+  m_StartCounters = PerfCounterGroup::forThread().read();
+}
+
+InstrumentationPerfCounters::InstrumentationPerfCounters(const char* name)
+    : InstrumentationPerfCounters(Instrumentor::Get().InternName(name)) {}
+
+InstrumentationPerfCounters::~InstrumentationPerfCounters() {
+  PerfSample counters = PerfCounterGroup::forThread().read() - m_StartCounters;
+  Instrumentor::Get().WriteCounters({m_NameId, Instrumentor::CurrentThreadID(),
+                                     m_Start, Instrumentor::NowMicros(),
+                                     counters});
+}
+
+InstrumentationTimerAccumulator::~InstrumentationTimerAccumulator() {
+  auto elapsed = std::chrono::steady_clock::now() - m_StartTimepoint;
+  Instrumentor::Get().RecordLatency(
+      m_NameId,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
@@ -0,0 +1,71 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+void LatencySummary::print(std::ostream& out) const {
+  auto flags = out.flags();
+  out << std::fixed << std::setprecision(1);
+  out << Count << " calls, us min " << Min / 1000.0 << " p50 " << P50 / 1000.0
+      << " p90 " << P90 / 1000.0 << " p99 " << P99 / 1000.0 << " p99.9 "
+      << P999 / 1000.0 << " max " << Max / 1000.0 << " mean " << Mean / 1000.0;
+  out.flags(flags);
+}
+
+void LatencySnapshot::merge(LatencyHistogram& histogram, bool reset) {
+  for (size_t i = 0; i < LatencyHistogram::kBucketCount; i++) {
+    uint64_t count =
+        reset ? histogram.m_Counts[i].exchange(0, std::memory_order_relaxed)
+              : histogram.m_Counts[i].load(std::memory_order_relaxed);
+    m_Counts[i] += count;
+    m_Count += count;
+  }
+
+  if (reset) {
+    m_Sum += histogram.m_Sum.exchange(0, std::memory_order_relaxed);
+    m_Min = std::min(m_Min, histogram.m_Min.exchange(
+                                std::numeric_limits<uint64_t>::max(),
+                                std::memory_order_relaxed));
+    m_Max = std::max(m_Max,
+                     histogram.m_Max.exchange(0, std::memory_order_relaxed));
+  } else {
+    m_Sum += histogram.m_Sum.load(std::memory_order_relaxed);
+    m_Min = std::min(m_Min, histogram.m_Min.load(std::memory_order_relaxed));
+    m_Max = std::max(m_Max, histogram.m_Max.load(std::memory_order_relaxed));
+  }
+}
+
+uint64_t LatencySnapshot::percentile(double q) const {
+  if (m_Count == 0) return 0;
+
+  uint64_t rank = static_cast<uint64_t>(std::ceil(q * m_Count));
+  rank = std::clamp<uint64_t>(rank, 1, m_Count);
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < LatencyHistogram::kBucketCount; i++) {
+    seen += m_Counts[i];
+    if (seen >= rank) {
+      // Report the middle of the bucket, kept within the exact extremes
+      uint64_t value = LatencyHistogram::bucketLowest(i) +
+                       (LatencyHistogram::bucketWidth(i) - 1) / 2;
+      return std::clamp(value, std::min(m_Min, m_Max), m_Max);
+    }
+  }
+  return m_Max;
+}
+
+LatencySummary LatencySnapshot::summary() const {
+  LatencySummary summary;
+  summary.Count = m_Count;
+  if (m_Count == 0) return summary;
+
+  summary.Min = m_Min;
+  summary.P50 = percentile(0.5);
+  summary.P90 = percentile(0.9);
+  summary.P99 = percentile(0.99);
+  summary.P999 = percentile(0.999);
+  summary.Max = m_Max;
+  summary.Mean = static_cast<double>(m_Sum) / m_Count;
+  return summary;
+}
@@ -0,0 +1,32 @@
+#include "Layer.h"
+
+#include <cstring>
+
+Layer::~Layer() {
+  if (output != nullptr) {
+    delete output;
+    output = nullptr;
+  }
+}
+
+void Layer::forward(const ByteMatrix& inputs) {
+  Matrix converted(inputs.numRows(), inputs.numColumns());
+  const uint8_t* in = inputs.data();
+  double* out = converted.data();
+  for (size_t i = 0; i < inputs.numRows() * inputs.numColumns(); ++i) {
+    out[i] = in[i] / 255.0;
+  }
+  forward(converted);
+}
+
+void Layer::forwardRows(const double* input, size_t rows, size_t cols) {
+  Matrix copy(rows, cols);
+  std::memcpy(copy.data(), input, rows * cols * sizeof(double));
+  forward(copy);
+}
+
+void Layer::forwardRows(const uint8_t* input, size_t rows, size_t cols) {
+  ByteMatrix copy(rows, cols);
+  std::memcpy(copy.data(), input, rows * cols);
+  forward(copy);
+}
@@ -0,0 +1,224 @@
+#include "LayerConv2D.h"
+
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include "LayerDense.h"
+
+LayerConv2D::LayerConv2D(size_t inChannels, size_t outChannels,
+                         size_t kernelSize, size_t stride, size_t padding,
+                         ActivationMethod activation)
+    : m_inChannels(inChannels),
+      m_outChannels(outChannels),
+      m_kernelSize(kernelSize),
+      m_stride(stride),
+      m_padding(padding),
+      m_inputHeight(0),
+      m_inputWidth(0),
+      m_weights(kernelSize * kernelSize * inChannels, outChannels),
+      m_biases(1, outChannels),
+      m_activation(activation) {
+  if (stride == 0) {
+    throw std::invalid_argument("Convolution stride must be at least 1.");
+  }
+
+  // Initialize the weights with random values between -1 and 1.
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+  for (size_t i = 0; i < m_weights.numRows(); ++i) {
+    for (size_t j = 0; j < m_weights.numColumns(); ++j) {
+      m_weights(i, j) = distribution(gen);
+    }
+  }
+}
+
+LayerConv2D::LayerConv2D(const LayerDense& dense, size_t inChannels,
+                         size_t kernelSize)
+    : m_inChannels(inChannels),
+      m_outChannels(dense.getWeights().numColumns()),
+      m_kernelSize(kernelSize),
+      m_stride(1),
+      m_padding(0),
+      m_inputHeight(0),
+      m_inputWidth(0),
+      m_weights(dense.getWeights()),
+      m_biases(dense.getBiases()),
+      m_activation(dense.getActivation()) {
+  if (m_weights.numRows() != kernelSize * kernelSize * inChannels) {
+    throw std::invalid_argument(
+        "Dense layer input size does not match the convolution window.");
+  }
+}
+
+void LayerConv2D::forward(const Matrix& inputs) {
+  if (inputs.numColumns() != m_inChannels) {
+    throw std::invalid_argument(
+        "Input channels do not match the layer's input channels.");
+  }
+  if (inputs.numRows() != m_inputHeight * m_inputWidth) {
+    throw std::invalid_argument(
+        "Input size does not match the size set with setInputSize.");
+  }
+
+  const size_t outHeight = outputHeight();
+  const size_t outWidth = outputWidth();
+
+  // Accumulate straight into the output, reusing its storage between frames
+  if (output == nullptr) {
+    output = new Matrix(outHeight * outWidth, m_outChannels);
+  } else {
+    output->resize(outHeight * outWidth, m_outChannels);
+  }
+  Matrix& preActivation = *output;
+
+  const double* in = inputs.data();
+  const double* weights = m_weights.data();
+  const long height = static_cast<long>(m_inputHeight);
+  const long width = static_cast<long>(m_inputWidth);
+  const long kernel = static_cast<long>(m_kernelSize);
+  const long padding = static_cast<long>(m_padding);
+
+  // Direct convolution: every input value is read straight from the shared
+  // tensor by each window that overlaps it, rather than being copied into a
+  // per-pixel neighbourhood first. Taps are accumulated in the same order as
+  // the equivalent dense layer so the results are identical.
+  for (size_t oy = 0; oy < outHeight; ++oy) {
+    const long top = static_cast<long>(oy * m_stride) - padding;
+    for (size_t ox = 0; ox < outWidth; ++ox) {
+      const long left = static_cast<long>(ox * m_stride) - padding;
+      double* acc = &preActivation(oy * outWidth + ox, 0);
+      for (size_t n = 0; n < m_outChannels; ++n) acc[n] = 0.0;
+
+      const double* tapWeights = weights;
+      for (long kx = 0; kx < kernel; ++kx) {
+        const long ix = left + kx;
+        for (size_t c = 0; c < m_inChannels; ++c) {
+          for (long ky = 0; ky < kernel; ++ky) {
+            const long iy = top + ky;
+            if (ix >= 0 && ix < width && iy >= 0 && iy < height) {
+              const double x = in[(iy * width + ix) * m_inChannels + c];
+              for (size_t n = 0; n < m_outChannels; ++n) {
+                acc[n] += x * tapWeights[n];
+              }
+            }
+            tapWeights += m_outChannels;
+          }
+        }
+      }
+
+      for (size_t n = 0; n < m_outChannels; ++n) {
+        acc[n] = acc[n] + m_biases(0, n);
+      }
+    }
+  }
+
+  m_activation.apply(preActivation);
+}
+
+void LayerConv2D::setInputSize(size_t height, size_t width) {
+  if (height + 2 * m_padding < m_kernelSize ||
+      width + 2 * m_padding < m_kernelSize) {
+    throw std::invalid_argument("Input is smaller than the convolution kernel.");
+  }
+  m_inputHeight = height;
+  m_inputWidth = width;
+}
+
+void LayerConv2D::setWeights(const Matrix& weights) {
+  if (weights.numRows() != m_weights.numRows() ||
+      weights.numColumns() != m_weights.numColumns()) {
+    throw std::invalid_argument(
+        "Weights matrix size does not match the layer's weights matrix size.");
+  }
+
+  m_weights = weights;
+}
+
+void LayerConv2D::setBiases(const Matrix& biases) {
+  if (biases.numRows() != m_biases.numRows() ||
+      biases.numColumns() != m_biases.numColumns()) {
+    throw std::invalid_argument(
+        "Biases matrix size does not match the layer's biases matrix size.");
+  }
+
+  m_biases = biases;
+}
+
+size_t LayerConv2D::outputHeight() const {
+  if (m_inputHeight == 0) return 0;
+  return (m_inputHeight + 2 * m_padding - m_kernelSize) / m_stride + 1;
+}
+
+size_t LayerConv2D::outputWidth() const {
+  if (m_inputWidth == 0) return 0;
+  return (m_inputWidth + 2 * m_padding - m_kernelSize) / m_stride + 1;
+}
+
+void LayerConv2D::save(std::ofstream& file) const {
+  file.write("\x20", 1);
+
+  int32_t activationValue =
+      static_cast<int32_t>(m_activation.getActivationMethod());
+  file.write(reinterpret_cast<const char*>(&activationValue),
+             sizeof(activationValue));
+
+  int32_t shape[5] = {static_cast<int32_t>(m_inChannels),
+                      static_cast<int32_t>(m_outChannels),
+                      static_cast<int32_t>(m_kernelSize),
+                      static_cast<int32_t>(m_stride),
+                      static_cast<int32_t>(m_padding)};
+  file.write(reinterpret_cast<const char*>(shape), sizeof(shape));
+
+  file.write(reinterpret_cast<const char*>(m_weights.data()),
+             m_weights.numRows() * m_weights.numColumns() * sizeof(double));
+  file.write(reinterpret_cast<const char*>(m_biases.data()),
+             m_biases.numColumns() * sizeof(double));
+}
+
+void LayerConv2D::load(std::ifstream& file) {
+  char identifier;
+  file.read(&identifier, 1);
+  if (identifier != '\x20') {
+    throw std::invalid_argument("Invalid conv2d layer identifier.");
+  }
+
+  int32_t activationValue;
+  file.read(reinterpret_cast<char*>(&activationValue), sizeof(activationValue));
+  m_activation.setActivationMethod(
+      static_cast<ActivationMethod>(activationValue));
+
+  int32_t shape[5];
+  file.read(reinterpret_cast<char*>(shape), sizeof(shape));
+  m_inChannels = shape[0];
+  m_outChannels = shape[1];
+  m_kernelSize = shape[2];
+  m_stride = shape[3];
+  m_padding = shape[4];
+  if (m_stride == 0) {
+    throw std::invalid_argument("Convolution stride must be at least 1.");
+  }
+
+  m_weights = Matrix(m_kernelSize * m_kernelSize * m_inChannels, m_outChannels);
+  file.read(reinterpret_cast<char*>(m_weights.data()),
+            m_weights.numRows() * m_weights.numColumns() * sizeof(double));
+
+  m_biases = Matrix(1, m_outChannels);
+  file.read(reinterpret_cast<char*>(m_biases.data()),
+            m_outChannels * sizeof(double));
+}
+
+void LayerConv2D::print() const {
+  std::cout << "Layer Conv2D" << std::endl;
+  std::cout << "Activation: " << m_activation.toString() << std::endl;
+  std::cout << "Channels: " << m_inChannels << " -> " << m_outChannels
+            << ", kernel " << m_kernelSize << "x" << m_kernelSize
+            << ", stride " << m_stride << ", padding " << m_padding
+            << std::endl;
+  std::cout << "Weights: " << std::endl;
+  m_weights.print();
+  std::cout << "Biases: " << std::endl;
+  m_biases.print();
+}
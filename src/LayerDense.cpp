@@ -9,7 +9,8 @@ LayerDense::LayerDense(size_t n_inputs, size_t n_neurons,
     : m_weights(n_inputs, n_neurons),
       m_biases(1, n_neurons),
       m_activation(activation),
-      output(nullptr) {
+      m_byteWeights(0, 0),
+      m_converted(0, 0) {
   // Initialize the weights with random values between -1 and 1.
   std::random_device rd;
   std::mt19937 gen(rd());
@@ -25,33 +26,118 @@ LayerDense::LayerDense(size_t n_inputs, size_t n_neurons,
   for (size_t j = 0; j < n_neurons; ++j) {
     m_biases(0, j) = 0.0;
   }
+
+  prepareByteInputs();
 }
 
-LayerDense::~LayerDense() {
-  if (output != nullptr) {
-    delete output;
-    output = nullptr;
+void LayerDense::prepareByteInputs() {
+  size_t n_inputs = m_weights.numRows();
+  size_t n_neurons = m_weights.numColumns();
+  size_t entries = n_inputs * 256 * n_neurons;
+
+  if (entries * sizeof(double) > kMaxLookupTableBytes) {
+    m_lookupTable.clear();
+    m_lookupTable.shrink_to_fit();
+
+    m_byteWeights = Matrix(n_inputs, n_neurons);
+    for (size_t k = 0; k < n_inputs; ++k) {
+      for (size_t n = 0; n < n_neurons; ++n) {
+        m_byteWeights(k, n) = m_weights(k, n) / 255.0;
+      }
+    }
+    return;
+  }
+
+  m_byteWeights = Matrix(0, 0);
+  m_lookupTable.resize(entries);
+  double* entry = m_lookupTable.data();
+  for (size_t k = 0; k < n_inputs; ++k) {
+    for (int v = 0; v < 256; ++v) {
+      // Same product the GEMM path computes, so results match exactly
+      double x = v / 255.0;
+      for (size_t n = 0; n < n_neurons; ++n) {
+        *entry++ = x * m_weights(k, n);
+      }
+    }
   }
 }
 
 void LayerDense::forward(const Matrix& inputs) {
-  if (inputs.numColumns() != m_weights.numRows()) {
+  forwardRows(inputs.data(), inputs.numRows(), inputs.numColumns());
+}
+
+void LayerDense::forward(const ByteMatrix& inputs) {
+  forwardRows(inputs.data(), inputs.numRows(), inputs.numColumns());
+}
+
+void LayerDense::resizeOutput(size_t rows, size_t cols) {
+  if (cols != m_weights.numRows()) {
     throw std::invalid_argument(
         "Input size does not match the layer's input size.");
   }
 
-  // If output has been allocated and its dimensions match the expected
-  // dimensions
-  if (output != nullptr && output->numRows() == inputs.numRows() &&
-      output->numColumns() == m_biases.numColumns()) {
-    // Just overwrite the values
+  // Reuse the output's storage; a micro-batched pass alternates between two
+  // row counts, so only allocate when it has to grow
+  if (output == nullptr) {
+    output = new Matrix(rows, m_weights.numColumns());
   } else {
-    // Delete previous matrix and allocate new memory
-    delete output;
-    output = new Matrix(inputs.numRows(), m_biases.numColumns());
+    output->resize(rows, m_weights.numColumns());
+  }
+}
+
+void LayerDense::forwardRows(const double* inputs, size_t rows, size_t cols) {
+  resizeOutput(rows, cols);
+
+  // One pass per row into the existing output, then the activation in place.
+  // Same sums as evaluating inputs * m_weights + m_biases.
+  size_t n_neurons = m_weights.numColumns();
+  const double* biases = m_biases.data();
+  for (size_t i = 0; i < rows; ++i) {
+    double* out = output->data() + i * n_neurons;
+    matrixRowProduct(inputs + i * cols, m_weights, 1.0, out);
+    for (size_t n = 0; n < n_neurons; ++n) out[n] += biases[n];
+  }
+  m_activation.apply(*output);
+}
+
+void LayerDense::forwardRows(const uint8_t* inputs, size_t rows,
+                             size_t cols) {
+  resizeOutput(rows, cols);
+
+  size_t n_inputs = m_weights.numRows();
+  size_t n_neurons = m_weights.numColumns();
+  if (m_lookupTable.empty()) {
+    // The scale lives in m_byteWeights, so bytes convert without a divide
+    m_converted.resize(rows, n_inputs);
+    double* out = m_converted.data();
+    for (size_t i = 0; i < rows * n_inputs; ++i) {
+      out[i] = inputs[i];
+    }
+    Matrix::gemm(1.0, m_converted, m_byteWeights, 0.0, *output);
+    Matrix::addRowBroadcast(m_biases, *output);
+    m_activation.apply(*output);
+    return;
+  }
+
+  Matrix& preActivation = *output;
+  for (size_t i = 0; i < rows; ++i) {
+    const uint8_t* x = inputs + i * n_inputs;
+    double* acc = &preActivation(i, 0);
+    for (size_t n = 0; n < n_neurons; ++n) acc[n] = 0.0;
+
+    for (size_t k = 0; k < n_inputs; ++k) {
+      const double* row = &m_lookupTable[(k * 256 + x[k]) * n_neurons];
+      for (size_t n = 0; n < n_neurons; ++n) {
+        acc[n] += row[n];
+      }
+    }
+
+    for (size_t n = 0; n < n_neurons; ++n) {
+      acc[n] = acc[n] + m_biases(0, n);
+    }
   }
 
-  *output = m_activation.forward(inputs * m_weights + m_biases);
+  m_activation.apply(preActivation);
 }
 
 void LayerDense::setWeights(const Matrix& weights) {
@@ -62,6 +148,7 @@ void LayerDense::setWeights(const Matrix& weights) {
   }
 
   m_weights = weights;
+  prepareByteInputs();
 }
 
 void LayerDense::setBiases(const Matrix& biases) {
@@ -96,10 +183,10 @@ void LayerDense::save(std::ofstream& file) const {
   file.write(reinterpret_cast<const char*>(m_weights.data()),
              rows * cols * sizeof(double));
 
-  rows = static_cast<int32_t>(m_biases.numRows());
-  file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+  cols = static_cast<int32_t>(m_biases.numColumns());
+  file.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
   file.write(reinterpret_cast<const char*>(m_biases.data()),
-             rows * sizeof(double));
+             cols * sizeof(double));
 }
 
 void LayerDense::load(std::ifstream& file) {
@@ -122,10 +209,18 @@ void LayerDense::load(std::ifstream& file) {
   m_weights = Matrix(rows, cols);
   file.read(reinterpret_cast<char*>(m_weights.data()),
             rows * cols * sizeof(double));
-
-  file.read(reinterpret_cast<char*>(&rows), sizeof(rows));
-  m_biases = Matrix(rows, 1);
-  file.read(reinterpret_cast<char*>(m_biases.data()), rows * sizeof(double));
+  prepareByteInputs();
+
+  // Biases are a single row with one value per neuron. Files written before
+  // this was fixed only stored the first bias; the rest were always zero.
+  int32_t numBiases;
+  file.read(reinterpret_cast<char*>(&numBiases), sizeof(numBiases));
+  if (numBiases != cols && numBiases != 1) {
+    throw std::invalid_argument("Biases size does not match the layer size.");
+  }
+  m_biases = Matrix(1, cols);
+  file.read(reinterpret_cast<char*>(m_biases.data()),
+            numBiases * sizeof(double));
 }
 
 void LayerDense::print() const {
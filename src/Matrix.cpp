@@ -94,58 +94,102 @@ const double& Matrix::operator()(size_t col) const {
   return m_data[col];
 }
 
-Matrix Matrix::dotProduct(const Matrix& lhs, const Matrix& rhs) {
+void checkMatrixSum(size_t lhsRows, size_t lhsCols, size_t rhsRows,
+                    size_t rhsCols) {
+  if ((rhsRows != 1 && rhsRows != lhsRows) || rhsCols != lhsCols) {
+    throw std::invalid_argument(
+        "Matrices must have the same dimensions for addition.");
+  }
+}
+
+MatrixProduct::MatrixProduct(const Matrix& lhs, const Matrix& rhs)
+    : lhs(lhs), rhs(rhs) {
   // Check if the matrices are compatible for multiplication
   if (lhs.numColumns() != rhs.numRows()) {
     throw std::invalid_argument(
         "Number of columns in the left matrix must be equal to the number of "
         "rows in the right matrix.");
   }
+}
 
-  // Initialize the result matrix based on the input matrices' dimensions
-  size_t resultRows = lhs.numRows();
-  size_t resultCols = rhs.numColumns();
-  Matrix result(resultRows, resultCols);
-
-  // Perform matrix multiplication or dot product
-  for (size_t i = 0; i < resultRows; ++i) {
-    for (size_t j = 0; j < resultCols; ++j) {
-      double dotProduct = 0.0;
-      for (size_t k = 0; k < lhs.numColumns(); ++k) {
-        dotProduct += lhs(i, k) * rhs(k, j);
-      }
-      result(i, j) = dotProduct;
-    }
-  }
+Matrix Matrix::dotProduct(const Matrix& lhs, const Matrix& rhs) {
+  return lhs * rhs;
+}
 
-  return result;
+Matrix Matrix::add(const Matrix& lhs, const Matrix& rhs) { return lhs + rhs; }
+
+void Matrix::resize(size_t rows, size_t cols) {
+  m_data.resize(rows * cols);
+  m_rows = rows;
+  m_cols = cols;
 }
 
-Matrix Matrix::operator*(const Matrix& rhs) const {
-  return dotProduct(*this, rhs);
+Matrix& Matrix::operator*=(double alpha) {
+  scale(alpha, *this);
+  return *this;
 }
 
-Matrix Matrix::add(const Matrix& lhs, const Matrix& rhs) {
-  if ((rhs.numRows() != 1) && (lhs.numRows() != rhs.numRows() ||
-                               lhs.numColumns() != rhs.numColumns())) {
+void Matrix::gemm(double alpha, const Matrix& a, const Matrix& b, double beta,
+                  Matrix& c) {
+  if (a.numColumns() != b.numRows()) {
     throw std::invalid_argument(
-        "Matrices must have the same dimensions for addition.");
+        "Number of columns in the left matrix must be equal to the number of "
+        "rows in the right matrix.");
+  }
+  if (c.numRows() != a.numRows() || c.numColumns() != b.numColumns()) {
+    throw std::invalid_argument("gemm output has the wrong dimensions.");
+  }
+  if (&c == &a || &c == &b) {
+    throw std::invalid_argument("gemm output must not be one of its inputs.");
   }
 
-  size_t rows = lhs.numRows();
-  size_t cols = lhs.numColumns();
-  Matrix result(rows, cols);
-
-  for (size_t i = 0; i < rows; ++i) {
-    for (size_t j = 0; j < cols; ++j) {
-      result(i, j) = lhs(i, j) + rhs(rhs.numRows() > 1 ? i : 0, j);
+  const size_t inner = a.numColumns();
+  const size_t cols = b.numColumns();
+  // beta == 0 overwrites, so NaNs already in c don't leak through. Otherwise
+  // each product row goes through a per-thread scratch row that is only
+  // reallocated when c gets wider.
+  thread_local std::vector<double> scratch;
+  if (beta != 0.0 && scratch.size() < cols) scratch.resize(cols);
+  for (size_t i = 0; i < a.numRows(); ++i) {
+    double* out = c.data() + i * cols;
+    const double* a_row = a.data() + i * inner;
+    if (beta == 0.0) {
+      matrixRowProduct(a_row, b, alpha, out);
+      continue;
     }
+    matrixRowProduct(a_row, b, alpha, scratch.data());
+    for (size_t j = 0; j < cols; ++j) out[j] = beta * out[j] + scratch[j];
   }
+}
 
-  return result;
+void Matrix::axpy(double alpha, const Matrix& x, Matrix& y) {
+  if (x.numRows() != y.numRows() || x.numColumns() != y.numColumns()) {
+    throw std::invalid_argument(
+        "Matrices must have the same dimensions for addition.");
+  }
+  const double* in = x.data();
+  double* out = y.data();
+  for (size_t i = 0; i < y.numRows() * y.numColumns(); ++i) {
+    out[i] += alpha * in[i];
+  }
+}
+
+void Matrix::scale(double alpha, Matrix& x) {
+  double* values = x.data();
+  for (size_t i = 0; i < x.numRows() * x.numColumns(); ++i) values[i] *= alpha;
 }
 
-Matrix Matrix::operator+(const Matrix& rhs) const { return add(*this, rhs); }
+void Matrix::addRowBroadcast(const Matrix& row, Matrix& c) {
+  if (row.numRows() != 1 || row.numColumns() != c.numColumns()) {
+    throw std::invalid_argument(
+        "Broadcast row must be a single row as wide as the matrix.");
+  }
+  const size_t cols = c.numColumns();
+  for (size_t i = 0; i < c.numRows(); ++i) {
+    double* out = c.data() + i * cols;
+    for (size_t j = 0; j < cols; ++j) out[j] += row.data()[j];
+  }
+}
 
 Matrix Matrix::transpose() const {
   Matrix result(m_cols, m_rows);
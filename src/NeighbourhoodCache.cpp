@@ -0,0 +1,85 @@
+#include "NeighbourhoodCache.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+double CacheStats::speedup() const {
+  size_t misses = Lookups - Hits;
+  if (misses == 0 || CacheSeconds + NetworkSeconds <= 0.0) return 0.0;
+  double uncachedSeconds = NetworkSeconds / misses * Lookups;
+  return uncachedSeconds / (CacheSeconds + NetworkSeconds);
+}
+
+void CacheStats::print() const {
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Neighbourhood cache: " << Lookups << " lookups, "
+            << 100.0 * hitRate() << "% hits, " << Evictions << " evictions, "
+            << std::setprecision(2) << speedup() << "x estimated speedup"
+            << std::endl;
+  std::cout.unsetf(std::ios::fixed);
+}
+
+NeighbourhoodCache::NeighbourhoodCache(size_t maxBytes) {
+  size_t entries = 1;
+  while (entries * 2 * sizeof(Entry) <= maxBytes) entries *= 2;
+  if (entries * sizeof(Entry) > maxBytes) {
+    throw std::invalid_argument("Cache size is smaller than one entry.");
+  }
+
+  m_entries.resize(entries);
+  m_mask = entries - 1;
+  clear();
+}
+
+void NeighbourhoodCache::clear() {
+  std::memset(m_entries.data(), 0, m_entries.size() * sizeof(Entry));
+}
+
+uint64_t NeighbourhoodCache::hash(const uint8_t* key) {
+  uint64_t words[4] = {0, 0, 0, 0};
+  std::memcpy(words, key, kKeySize);
+
+  uint64_t h = 0x9E3779B97F4A7C15ull;
+  for (uint64_t word : words) {
+    h ^= word;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 32;
+  }
+  return h;
+}
+
+bool NeighbourhoodCache::lookup(const uint8_t* key, uint8_t* value) {
+  m_stats.Lookups++;
+
+  size_t slot = hash(key) & m_mask;
+  for (size_t probe = 0; probe < kMaxProbes; probe++) {
+    const Entry& entry = m_entries[(slot + probe) & m_mask];
+    if (!entry.Used) return false;
+    if (std::memcmp(entry.Key, key, kKeySize) == 0) {
+      std::memcpy(value, entry.Value, kValueSize);
+      m_stats.Hits++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void NeighbourhoodCache::insert(const uint8_t* key, const uint8_t* value) {
+  size_t home = hash(key) & m_mask;
+  Entry* target = &m_entries[home];
+
+  for (size_t probe = 0; probe < kMaxProbes; probe++) {
+    Entry& entry = m_entries[(home + probe) & m_mask];
+    if (!entry.Used || std::memcmp(entry.Key, key, kKeySize) == 0) {
+      target = &entry;
+      break;
+    }
+    if (probe == kMaxProbes - 1) m_stats.Evictions++;
+  }
+
+  std::memcpy(target->Key, key, kKeySize);
+  std::memcpy(target->Value, value, kValueSize);
+  target->Used = 1;
+}
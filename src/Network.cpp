@@ -1,14 +1,117 @@
 #include "Network.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
+#include <utility>
+#include <variant>
+
+#include "BoundedQueue.h"
+#include "CacheInfo.h"
+
+struct Network::AsyncWorker {
+  struct Job {
+    std::variant<Matrix, ByteMatrix> Inputs = Matrix(0, 0);
+    std::promise<Matrix> Result;
+    ForwardCallback Callback;
+  };
+
+  BoundedQueue<Job> Jobs{kAsyncSlots};
+  std::thread Thread;
+
+  // Output buffers handed back through RecycleOutputs, one per batch that
+  // can be in flight
+  std::mutex SpareMutex;
+  std::vector<Matrix> Spare;
+};
 
 Network::Network(Matrix* inputs, int batchSize)
-    : m_inputs(inputs), m_batchSize(batchSize) {
+    : m_inputs(inputs),
+      m_batchSize(batchSize),
+      m_outputs(0, 0) {
   outputs = nullptr;
 }
 
-void Network::AddLayer(LayerDense* layer) { m_layers.emplace_back(layer); }
+Network::~Network() {
+  if (m_async) {
+    m_async->Jobs.close();
+    m_async->Thread.join();
+  }
+}
+
+void Network::AddLayer(Layer* layer) { m_layers.emplace_back(layer); }
+
+size_t Network::MicroBatchRows() const {
+  if (m_layers.empty()) return 0;
+
+  // LayerDense::forward evaluates straight into its output, so each layer
+  // costs one row of its width
+  size_t row_bytes = 0, weight_bytes = 0;
+  for (const Layer* layer : m_layers) {
+    const LayerDense* dense = dynamic_cast<const LayerDense*>(layer);
+    if (dense == nullptr) return 0;
+    const Matrix& weights = dense->getWeights();
+    if (row_bytes == 0) row_bytes = weights.numRows() * sizeof(double);
+    row_bytes += weights.numColumns() * sizeof(double);
+    weight_bytes += (weights.numRows() + 1) * weights.numColumns() *
+                    sizeof(double);
+  }
+  if (m_batchSize > 1) return m_batchSize;
+
+  size_t l2 = cacheSizeBytes(2);
+  size_t budget = (l2 > 0 ? l2 : kDefaultL2Bytes) / 2;
+  budget = budget > weight_bytes ? budget - weight_bytes : 0;
+  return std::max(kMinMicroBatchRows, budget / row_bytes);
+}
+
+template <typename Element>
+void Network::forwardMicroBatches(const Element* inputs, size_t rows,
+                                  size_t cols, size_t rowsPerBatch,
+                                  const RowsCallback& callback) {
+  for (size_t begin = 0; begin < rows; begin += rowsPerBatch) {
+    size_t count = std::min(rowsPerBatch, rows - begin);
+
+    // The first layer reads the micro-batch where it is
+    m_layers[0]->forwardRows(inputs + begin * cols, count, cols);
+    Matrix* input = m_layers[0]->output;
+    for (size_t i = 1; i < m_layers.size(); i++) {
+      m_layers[i]->forward(*input);
+      input = m_layers[i]->output;
+    }
+    callback(begin, *input);
+  }
+}
+
+template <typename Inputs>
+Matrix* Network::forwardLayers(const Inputs& inputs) {
+  if (m_layers.empty()) {
+    throw std::invalid_argument("Network has no layers.");
+  }
+
+  size_t micro_batch = MicroBatchRows();
+  if (micro_batch > 0 && inputs.numRows() > micro_batch) {
+    const size_t rows = inputs.numRows();
+    forwardMicroBatches(
+        inputs.data(), rows, inputs.numColumns(), micro_batch,
+        [this, rows](size_t first, const Matrix& outputs) {
+          size_t cols = outputs.numColumns();
+          if (first == 0) m_outputs.resize(rows, cols);
+          std::memcpy(m_outputs.data() + first * cols, outputs.data(),
+                      outputs.numRows() * cols * sizeof(double));
+        });
+    return &m_outputs;
+  }
+
+  m_layers[0]->forward(inputs);
+  Matrix* input = m_layers[0]->output;
+  for (size_t i = 1; i < m_layers.size(); i++) {
+    m_layers[i]->forward(*input);
+    input = m_layers[i]->output;
+  }
+  return input;
+}
 
 void Network::Forward() {
   // Check if the inputs pointers are valid
@@ -18,13 +121,101 @@ void Network::Forward() {
         "calling Forward.");
   }
 
-  Matrix* input = m_inputs;
-  for (size_t i = 0; i < m_layers.size(); i++) {
-    m_layers[i]->forward(*input);
-    input = m_layers[i]->output;
+  outputs = m_layers.empty() ? m_inputs : forwardLayers(*m_inputs);
+}
+
+void Network::Forward(const ByteMatrix& inputs) {
+  outputs = forwardLayers(inputs);
+}
+
+void Network::Forward(const ByteMatrix& inputs, ByteMatrix& byteOutputs) {
+  Forward(inputs);
+  byteOutputs.quantize(*outputs);
+}
+
+void Network::ForwardRows(const double* inputs, size_t rows, size_t cols,
+                          const RowsCallback& callback) {
+  if (m_layers.empty()) {
+    throw std::invalid_argument("Network has no layers.");
   }
 
-  outputs = input;
+  size_t micro_batch = MicroBatchRows();
+  forwardMicroBatches(inputs, rows, cols, micro_batch > 0 ? micro_batch : rows,
+                      callback);
+}
+
+Network::AsyncWorker& Network::asyncWorker() {
+  std::lock_guard<std::mutex> lock(m_asyncMutex);
+  if (m_async) return *m_async;
+
+  m_async = std::make_unique<AsyncWorker>();
+  m_async->Spare.reserve(kAsyncSlots + 1);
+  m_async->Thread = std::thread([this, &async = *m_async] {
+    AsyncWorker::Job job;
+    while (async.Jobs.pop(job)) {
+      Matrix result(0, 0);
+      std::exception_ptr error;
+      try {
+        Matrix* output = std::visit(
+            [this](const auto& inputs) { return forwardLayers(inputs); },
+            job.Inputs);
+        // Takes the buffer from the network or the last layer and gives it a
+        // recycled one in exchange, so once outputs come back nothing is
+        // allocated or copied
+        {
+          std::lock_guard<std::mutex> lock(async.SpareMutex);
+          if (!async.Spare.empty()) {
+            result = std::move(async.Spare.back());
+            async.Spare.pop_back();
+          }
+        }
+        std::swap(result, *output);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      // Frees the inputs before the caller hears the batch is done
+      job.Inputs = Matrix(0, 0);
+
+      if (job.Callback) {
+        job.Callback(std::move(result), error);
+      } else if (error) {
+        job.Result.set_exception(error);
+      } else {
+        job.Result.set_value(std::move(result));
+      }
+    }
+  });
+  return *m_async;
+}
+
+std::future<Matrix> Network::ForwardAsync(Matrix inputs) {
+  AsyncWorker::Job job{std::move(inputs), {}, nullptr};
+  std::future<Matrix> result = job.Result.get_future();
+  asyncWorker().Jobs.push(std::move(job));
+  return result;
+}
+
+std::future<Matrix> Network::ForwardAsync(ByteMatrix inputs) {
+  AsyncWorker::Job job{std::move(inputs), {}, nullptr};
+  std::future<Matrix> result = job.Result.get_future();
+  asyncWorker().Jobs.push(std::move(job));
+  return result;
+}
+
+void Network::ForwardAsync(Matrix inputs, ForwardCallback callback) {
+  asyncWorker().Jobs.push({std::move(inputs), {}, std::move(callback)});
+}
+
+void Network::ForwardAsync(ByteMatrix inputs, ForwardCallback callback) {
+  asyncWorker().Jobs.push({std::move(inputs), {}, std::move(callback)});
+}
+
+void Network::RecycleOutputs(Matrix outputs) {
+  AsyncWorker& async = asyncWorker();
+  std::lock_guard<std::mutex> lock(async.SpareMutex);
+  if (async.Spare.size() < kAsyncSlots + 1) {
+    async.Spare.push_back(std::move(outputs));
+  }
 }
 
 void Network::SetInputs(Matrix* inputs) { m_inputs = inputs; }
@@ -57,7 +248,17 @@ void Network::Load(std::ifstream& file) {
 
   m_layers.clear();
   for (int32_t i = 0; i < num_layers; i++) {
-    LayerDense* layer = new LayerDense(0, 0, ActivationMethod::NONE);
+    Layer* layer;
+    switch (file.peek()) {
+      case '\x10':
+        layer = new LayerDense(0, 0, ActivationMethod::NONE);
+        break;
+      case '\x20':
+        layer = new LayerConv2D(0, 0, 0, 1, 0, ActivationMethod::NONE);
+        break;
+      default:
+        throw std::invalid_argument("Invalid layer identifier.");
+    }
     layer->load(file);
     layer->print();
     m_layers.emplace_back(layer);
@@ -0,0 +1,162 @@
+#include "PerfCounters.h"
+
+#include <ctime>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+const char* perfCounterName(PerfCounter counter) {
+  switch (counter) {
+    case PerfCounter::Cycles:
+      return "cycles";
+    case PerfCounter::Instructions:
+      return "instructions";
+    case PerfCounter::L1DMisses:
+      return "l1d_misses";
+    case PerfCounter::LLCMisses:
+      return "llc_misses";
+    case PerfCounter::BranchMisses:
+      return "branch_misses";
+    default:
+      return "unknown";
+  }
+}
+
+PerfSample PerfSample::operator-(const PerfSample& start) const {
+  PerfSample delta;
+  delta.Available = Available & start.Available;
+  for (size_t i = 0; i < kPerfCounterCount; i++) {
+    delta.Values[i] = Values[i] - start.Values[i];
+  }
+  delta.CpuTimeNs = CpuTimeNs - start.CpuTimeNs;
+  delta.EnabledNs = EnabledNs - start.EnabledNs;
+  delta.RunningNs = RunningNs - start.RunningNs;
+
+  // The group shared the PMU with other events for part of the interval.
+  // It is scheduled as a whole, so every value is extrapolated from the time
+  // it ran; if it never ran there is nothing to extrapolate from.
+  if (delta.RunningNs < delta.EnabledNs) {
+    if (delta.RunningNs == 0) {
+      delta.Available = 0;
+    } else {
+      double scale = static_cast<double>(delta.EnabledNs) / delta.RunningNs;
+      for (uint64_t& value : delta.Values) {
+        value = static_cast<uint64_t>(value * scale);
+      }
+    }
+  }
+  return delta;
+}
+
+#ifdef __linux__
+namespace {
+
+int openCounter(uint32_t type, uint64_t config, int groupFd) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.disabled = groupFd == -1;  // the leader starts the whole group
+  // User space only, which is all perf_event_paranoid=2 allows
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+constexpr uint64_t cacheConfig(uint64_t cache, uint64_t op, uint64_t result) {
+  return cache | (op << 8) | (result << 16);
+}
+
+}  // namespace
+#endif
+
+PerfCounterGroup::PerfCounterGroup() : m_leaderFd(-1), m_opened(0),
+                                       m_available(0) {
+  m_fds.fill(-1);
+  m_slots.fill(0);
+
+#ifdef __linux__
+  const std::array<std::pair<uint32_t, uint64_t>, kPerfCounterCount> events = {{
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HW_CACHE,
+       cacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                   PERF_COUNT_HW_CACHE_RESULT_MISS)},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  }};
+
+  // Cycles lead the group; without them nothing else is opened. Other events
+  // a PMU doesn't support are left out individually.
+  for (size_t i = 0; i < kPerfCounterCount; i++) {
+    int fd = openCounter(events[i].first, events[i].second, m_leaderFd);
+    if (fd == -1) {
+      if (i == 0) return;
+      continue;
+    }
+    if (i == 0) m_leaderFd = fd;
+    m_fds[i] = fd;
+    m_slots[i] = m_opened++;
+    m_available |= 1u << i;
+  }
+
+  ioctl(m_leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(m_leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+#ifdef __linux__
+  for (int fd : m_fds) {
+    if (fd != -1) close(fd);
+  }
+#endif
+}
+
+PerfCounterGroup& PerfCounterGroup::forThread() {
+  thread_local PerfCounterGroup group;
+  return group;
+}
+
+PerfSample PerfCounterGroup::read() const {
+  PerfSample sample;
+
+#ifdef __linux__
+  if (m_leaderFd != -1) {
+    // The number of counters, the time enabled, the time running, then one
+    // value per counter
+    constexpr size_t kHeader = 3;
+    std::array<uint64_t, kHeader + kPerfCounterCount> buffer{};
+    const size_t expected = (kHeader + m_opened) * sizeof(uint64_t);
+    ssize_t bytes = ::read(m_leaderFd, buffer.data(), sizeof(buffer));
+    if (bytes >= static_cast<ssize_t>(expected)) {
+      sample.Available = m_available;
+      sample.EnabledNs = buffer[1];
+      sample.RunningNs = buffer[2];
+      for (size_t i = 0; i < kPerfCounterCount; i++) {
+        if (m_available & (1u << i)) {
+          sample.Values[i] = buffer[kHeader + m_slots[i]];
+        }
+      }
+    }
+  }
+#endif
+
+  timespec cpuTime;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime) == 0) {
+    sample.CpuTimeNs = static_cast<uint64_t>(cpuTime.tv_sec) * 1000000000ull +
+                       static_cast<uint64_t>(cpuTime.tv_nsec);
+  }
+  return sample;
+}
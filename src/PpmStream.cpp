@@ -0,0 +1,95 @@
+#include "PpmStream.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Skips whitespace and # comments between header fields
+void skipSeparators(std::ifstream& file) {
+  for (;;) {
+    int c = file.peek();
+    if (c == '#') {
+      std::string comment;
+      std::getline(file, comment);
+    } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      file.get();
+    } else {
+      return;
+    }
+  }
+}
+
+int readHeaderField(std::ifstream& file) {
+  skipSeparators(file);
+  int value = -1;
+  file >> value;
+  return value;
+}
+
+// RGB <-> BGR, in place
+void swapRedBlue(uchar* row, int cols) {
+  for (int x = 0; x < cols; x++) std::swap(row[3 * x], row[3 * x + 2]);
+}
+
+}  // namespace
+
+PpmReader::PpmReader(const std::string& filename)
+    : m_file(filename, std::ios::binary),
+      m_filename(filename),
+      m_rows(0),
+      m_cols(0),
+      m_next(0) {
+  if (!m_file.is_open()) {
+    throw std::invalid_argument("Failed to open the file: " + filename);
+  }
+
+  char magic[2] = {};
+  m_file.read(magic, 2);
+  m_cols = readHeaderField(m_file);
+  m_rows = readHeaderField(m_file);
+  int max_value = readHeaderField(m_file);
+  if (magic[0] != 'P' || magic[1] != '6' || !m_file || m_cols <= 0 ||
+      m_rows <= 0) {
+    throw std::invalid_argument("Not a binary PPM: " + filename);
+  }
+  if (max_value != 255) {
+    throw std::invalid_argument("Only 8-bit PPMs are supported: " + filename);
+  }
+  // Exactly one whitespace character separates the header from the pixels
+  m_file.get();
+}
+
+void PpmReader::read(cv::Mat& band, int first, int count) {
+  for (int i = 0; i < count; i++) {
+    uchar* row = band.ptr<uchar>(first + i);
+    m_file.read(reinterpret_cast<char*>(row), 3 * static_cast<size_t>(m_cols));
+    if (!m_file) {
+      throw std::invalid_argument("Unexpected end of image: " + m_filename);
+    }
+    swapRedBlue(row, m_cols);
+  }
+  m_next += count;
+}
+
+PpmWriter::PpmWriter(const std::string& filename, int rows, int cols)
+    : m_file(filename, std::ios::binary),
+      m_filename(filename),
+      m_cols(cols),
+      m_row(3 * static_cast<size_t>(cols)) {
+  if (!m_file.is_open()) {
+    throw std::invalid_argument("Failed to open the file: " + filename);
+  }
+  m_file << "P6\n" << cols << " " << rows << "\n255\n";
+}
+
+void PpmWriter::write(const cv::Mat& band, int first, int count) {
+  for (int i = 0; i < count; i++) {
+    std::copy_n(band.ptr<uchar>(first + i), m_row.size(), m_row.begin());
+    swapRedBlue(m_row.data(), m_cols);
+    m_file.write(reinterpret_cast<const char*>(m_row.data()), m_row.size());
+  }
+  if (!m_file) {
+    throw std::invalid_argument("Failed to write the file: " + m_filename);
+  }
+}
@@ -0,0 +1,253 @@
+#include "TrainingData.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#include "ImageFilter.h"
+#include "Instrumentor.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}  // namespace
+
+void TrainingDataStats::print() const {
+  double rate = WallSeconds > 0.0 ? Samples / WallSeconds : 0.0;
+  double stalled =
+      WallSeconds > 0.0 ? 100.0 * StallSeconds / WallSeconds : 0.0;
+
+  std::streamsize precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << Samples << " samples in " << Batches << " batches from "
+            << Images << " image pairs in " << WallSeconds << " s ("
+            << rate / 1e6 << " M samples/s)" << std::endl;
+  std::cout << "  consumer stalled: " << StallSeconds << " s (" << stalled
+            << "%)" << std::endl;
+  std::cout << "  decode: " << DecodeSeconds << " s busy across threads"
+            << std::endl;
+  std::cout.unsetf(std::ios::fixed);
+  std::cout.precision(precision);
+}
+
+TrainingDataPipeline::TrainingDataPipeline(std::vector<ImagePair> pairs,
+                                           const TrainingDataOptions& options)
+    : m_pairs(std::move(pairs)),
+      m_options(options),
+      // Room for a couple of images per decoder beyond the one being built
+      m_samples(2 * std::max<size_t>(options.DecodeThreads, 1)),
+      m_batches(options.PrefetchBatches),
+      m_nextImage(0),
+      m_activeDecoders(std::max<size_t>(options.DecodeThreads, 1)),
+      m_images(0),
+      m_decodeNanoseconds(0),
+      m_samplesDelivered(0),
+      m_batchesDelivered(0),
+      m_stallSeconds(0.0) {
+  m_options.BatchSize = std::max<size_t>(m_options.BatchSize, 1);
+  m_options.ShuffleBuffer = std::max<size_t>(m_options.ShuffleBuffer, 1);
+  m_options.DecodeThreads = std::max<size_t>(m_options.DecodeThreads, 1);
+
+  // Images are visited in a fresh random order every epoch
+  std::mt19937 gen(m_options.Seed);
+  std::vector<size_t> epoch(m_pairs.size());
+  std::iota(epoch.begin(), epoch.end(), 0);
+  for (size_t e = 0; e < m_options.Epochs; e++) {
+    std::shuffle(epoch.begin(), epoch.end(), gen);
+    m_order.insert(m_order.end(), epoch.begin(), epoch.end());
+  }
+
+  m_start = Clock::now();
+  m_batcher = std::thread(&TrainingDataPipeline::shuffle, this);
+  for (size_t i = 0; i < m_options.DecodeThreads; i++) {
+    m_decoders.emplace_back(&TrainingDataPipeline::decode, this);
+  }
+}
+
+TrainingDataPipeline::~TrainingDataPipeline() {
+  // Stops the threads early if the consumer didn't drain the pipeline
+  m_batches.close();
+  m_samples.close();
+  for (std::thread& decoder : m_decoders) decoder.join();
+  m_batcher.join();
+}
+
+bool TrainingDataPipeline::next(TrainingBatch& batch) {
+  Clock::time_point wait = Clock::now();
+  bool got = m_batches.pop(batch);
+  m_stallSeconds += secondsSince(wait);
+
+  if (!got) {
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    if (m_error) std::rethrow_exception(m_error);
+    return false;
+  }
+  m_samplesDelivered += batch.size();
+  m_batchesDelivered++;
+  return true;
+}
+
+TrainingDataStats TrainingDataPipeline::stats() const {
+  TrainingDataStats stats;
+  stats.Images = m_images.load();
+  stats.Samples = m_samplesDelivered;
+  stats.Batches = m_batchesDelivered;
+  stats.WallSeconds = secondsSince(m_start);
+  stats.StallSeconds = m_stallSeconds;
+  stats.DecodeSeconds = m_decodeNanoseconds.load() / 1e9;
+  return stats;
+}
+
+std::vector<TrainingDataPipeline::ImagePair>
+TrainingDataPipeline::pairsFromGlobs(const std::string& inputs,
+                                     const std::string& targets) {
+  std::vector<std::string> input_files, target_files;
+  cv::glob(inputs, input_files, false);
+  cv::glob(targets, target_files, false);
+  std::sort(input_files.begin(), input_files.end());
+  std::sort(target_files.begin(), target_files.end());
+
+  if (input_files.empty()) {
+    throw std::invalid_argument("No images match: " + inputs);
+  }
+  if (input_files.size() != target_files.size()) {
+    throw std::invalid_argument(
+        "Input and target globs match a different number of images.");
+  }
+
+  std::vector<ImagePair> pairs;
+  for (size_t i = 0; i < input_files.size(); i++) {
+    pairs.push_back({input_files[i], target_files[i]});
+  }
+  return pairs;
+}
+
+void TrainingDataPipeline::fail(std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    if (!m_error) m_error = error;
+  }
+  m_samples.close();
+  m_batches.close();
+}
+
+void TrainingDataPipeline::extract(const cv::Mat& input, const cv::Mat& target,
+                                   std::vector<Sample>& samples) {
+  samples.resize(static_cast<size_t>(std::max(input.rows - 2, 0)) *
+                 std::max(input.cols - 2, 0));
+  Sample* sample = samples.data();
+  for (int y = 1; y < input.rows - 1; y++) {
+    const uchar* target_row = target.ptr<uchar>(y);
+    for (int x = 1; x < input.cols - 1; x++, sample++) {
+      gatherNeighbourhood(input, y, x, sample->Inputs);
+      for (int ch = 0; ch < 3; ch++) {
+        sample->Target[ch] = target_row[3 * x + ch];
+      }
+    }
+  }
+}
+
+void TrainingDataPipeline::decode() {
+  try {
+    for (;;) {
+      size_t step = m_nextImage.fetch_add(1);
+      if (step >= m_order.size()) break;
+      const ImagePair& pair = m_pairs[m_order[step]];
+
+      Clock::time_point busy = Clock::now();
+      std::vector<Sample> samples;
+      {
+        PROFILE_SCOPE("TrainingData decode");
+        cv::Mat input = cv::imread(pair.Input);
+        cv::Mat target = cv::imread(pair.Target);
+        if (input.empty() || target.empty()) {
+          std::cerr << "Failed to load image pair: " << pair.Input << ", "
+                    << pair.Target << std::endl;
+          continue;
+        }
+        if (input.rows != target.rows || input.cols != target.cols) {
+          std::cerr << "Input and target sizes differ: " << pair.Input
+                    << std::endl;
+          continue;
+        }
+        extract(input, target, samples);
+      }
+      m_decodeNanoseconds +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               busy)
+              .count();
+      m_images++;
+
+      if (!m_samples.push(std::move(samples))) break;
+    }
+  } catch (...) {
+    fail(std::current_exception());
+  }
+  // The last decoder out lets the batcher drain the shuffle buffer
+  if (--m_activeDecoders == 0) m_samples.close();
+}
+
+void TrainingDataPipeline::shuffle() {
+  try {
+    std::mt19937 gen(m_options.Seed + 1);
+    std::vector<Sample> buffer;
+    buffer.reserve(m_options.ShuffleBuffer);
+    std::vector<Sample> staged;
+    staged.reserve(m_options.BatchSize);
+
+    auto flush = [&]() {
+      TrainingBatch batch{Matrix(staged.size(), 27),
+                          Matrix(staged.size(), 3)};
+      double* inputs = batch.Inputs.data();
+      double* targets = batch.Targets.data();
+      for (const Sample& sample : staged) {
+        for (int k = 0; k < 27; k++) *inputs++ = sample.Inputs[k] / 255.0;
+        for (int ch = 0; ch < 3; ch++) *targets++ = sample.Target[ch] / 255.0;
+      }
+      staged.clear();
+      return m_batches.push(std::move(batch));
+    };
+
+    // Moves a random sample from the buffer into the batch being built
+    auto emit = [&]() {
+      size_t pick = std::uniform_int_distribution<size_t>(
+          0, buffer.size() - 1)(gen);
+      std::swap(buffer[pick], buffer.back());
+      staged.push_back(buffer.back());
+      buffer.pop_back();
+      return staged.size() < m_options.BatchSize || flush();
+    };
+
+    std::vector<Sample> samples;
+    while (m_samples.pop(samples)) {
+      for (const Sample& sample : samples) {
+        if (buffer.size() == m_options.ShuffleBuffer && !emit()) return;
+        buffer.push_back(sample);
+      }
+    }
+
+    bool stopped = false;
+    {
+      std::lock_guard<std::mutex> lock(m_errorMutex);
+      stopped = m_error != nullptr;
+    }
+    if (!stopped) {
+      while (!buffer.empty()) {
+        if (!emit()) return;
+      }
+      if (!staged.empty()) flush();
+    }
+  } catch (...) {
+    fail(std::current_exception());
+  }
+  m_batches.close();
+}
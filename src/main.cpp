@@ -1,97 +1,94 @@
+#include <exception>
 #include <iostream>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <thread>
 #include <unordered_set>
 #include <vector>
 
+#include "FramePipeline.h"
+#include "ImageFilter.h"
+#include "IncrementalFilter.h"
 #include "Network.h"
 
-std::vector<std::vector<double>> processRow(const cv::Mat& in_img, int y) {
-  std::vector<std::vector<double>> row_data;
-  row_data.reserve(in_img.cols - 2);
-
-  for (int x = 1; x < in_img.cols - 1; x++) {
-    std::vector<double> neighborhood;
-    neighborhood.reserve(27);
-
-    const uchar* previous_row = in_img.ptr<uchar>(y - 1);
-    const uchar* current_row = in_img.ptr<uchar>(y);
-    const uchar* next_row = in_img.ptr<uchar>(y + 1);
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <input_filename> <output_filename> [network_file]"
+                 " [--conv | --cache-mb N | --stream [--band-rows N]]"
+              << std::endl;
+    std::cerr << "       " << argv[0]
+              << " --sequence <frame_glob|video> <output_dir|video>"
+                 " [network_file]"
+                 " [--conv | --cache-mb N | --incremental [--tile-size N]]"
+              << std::endl;
+    return 1;  // exit with an error code
+  }
 
-    for (int offset = -3; offset <= 3; offset += 3) {
-      for (int ch = 0; ch < 3; ch++) {
-        neighborhood.push_back(previous_row[3 * x + offset + ch] / 255.0);
-        neighborhood.push_back(current_row[3 * x + offset + ch] / 255.0);
-        neighborhood.push_back(next_row[3 * x + offset + ch] / 255.0);
-      }
+  std::vector<std::string> positional;
+  bool use_conv = false;
+  bool sequence = false;
+  bool incremental = false;
+  bool stream = false;
+  int tile_size = 32;
+  int band_rows = 64;
+  size_t cache_mb = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--conv") {
+      use_conv = true;
+    } else if (arg == "--sequence") {
+      sequence = true;
+    } else if (arg == "--incremental") {
+      incremental = true;
+    } else if (arg == "--stream") {
+      stream = true;
+    } else if (arg == "--band-rows" && i + 1 < argc) {
+      band_rows = std::stoi(argv[++i]);
+    } else if (arg == "--tile-size" && i + 1 < argc) {
+      tile_size = std::stoi(argv[++i]);
+    } else if (arg == "--cache-mb" && i + 1 < argc) {
+      cache_mb = std::stoul(argv[++i]);
+    } else {
+      positional.push_back(arg);
     }
-
-    row_data.push_back(std::move(neighborhood));
   }
 
-  return row_data;
-}
-
-std::vector<cv::Vec3b> processRowPixels(
-    Network& network, const std::vector<std::vector<double>>& row_data) {
-  Matrix input(row_data);
-
-  network.SetInputs(&input);
-  network.Forward();
-
-  Matrix* output = network.outputs;
-
-  int numRows = output->numRows();
-  std::vector<cv::Vec3b> out_pixel_row(numRows);
-
-  for (int i = 0; i < numRows; i++) {
-    out_pixel_row[i] =
-        cv::Vec3b((*output)(i, 0) * 255.0, (*output)(i, 1) * 255.0,
-                  (*output)(i, 2) * 255.0);
+  if (positional.size() < 2) {
+    std::cerr << "Missing input or output." << std::endl;
+    return 1;
   }
 
-  return out_pixel_row;
-}
-
-void processImage(Network& network, const std::string& input_filename,
-                  const std::string& output_filename) {
-  cv::Mat in_img = cv::imread(input_filename);
-  if (in_img.empty()) {
-    std::cerr << "Failed to load image: " << input_filename << std::endl;
-    return;
+  if (incremental && (use_conv || !sequence)) {
+    std::cerr << "--incremental needs --sequence and cannot be combined "
+                 "with --conv."
+              << std::endl;
+    return 1;
   }
 
-  cv::Mat out_img = cv::Mat(in_img.rows, in_img.cols, in_img.type());
-
-  for (int y = 1; y < in_img.rows - 1; y++) {
-    std::vector<std::vector<double>> row_data = processRow(in_img, y);
-    std::vector<cv::Vec3b> out_pixel_row = processRowPixels(network, row_data);
-
-    for (int x = 1; x < in_img.cols - 1; x++) {
-      out_img.at<cv::Vec3b>(y, x) = out_pixel_row[x - 1];
-    }
+  if (cache_mb > 0 && (use_conv || incremental)) {
+    std::cerr << "--cache-mb cannot be combined with --conv or --incremental."
+              << std::endl;
+    return 1;
   }
 
-  cv::imwrite(output_filename, out_img);
-}
-
-int main(int argc, char* argv[]) {
-  if (argc < 3) {
-    std::cerr << "Usage: " << argv[0]
-              << " <input_filename> <output_filename> <network_file>"
+  if (stream && (sequence || use_conv || cache_mb > 0)) {
+    std::cerr << "--stream is for single PPM images and cannot be combined "
+                 "with --sequence, --conv or --cache-mb."
               << std::endl;
-    return 1;  // exit with an error code
+    return 1;
   }
 
-  std::string input_filename = argv[1];
-  std::string output_filename = argv[2];
+  std::string input_filename = positional[0];
+  std::string output_filename = positional[1];
   std::string network_filename;
 
-  if (argc == 4) {
-    network_filename = argv[3];
+  if (positional.size() > 2) {
+    network_filename = positional[2];
   }
 
-  Matrix X{{0}};
+  Matrix X(1, 1);
 
   // Create a Network object
   Network network(&X, 1);
@@ -119,7 +116,75 @@ int main(int argc, char* argv[]) {
               << std::endl;
   }
 
-  processImage(network, input_filename, output_filename);
+  // Run the first dense layer as the equivalent 3x3 convolution
+  std::unique_ptr<LayerConv2D> conv;
+  Network conv_network(nullptr, 1);
+  if (use_conv) {
+    LayerDense* first = dynamic_cast<LayerDense*>(network.GetLayers().front());
+    if (first == nullptr) {
+      std::cerr << "--conv expects the first layer to be dense." << std::endl;
+      return 1;
+    }
+    conv = std::make_unique<LayerConv2D>(*first, 3, 3);
+    conv_network.AddLayer(conv.get());
+    for (size_t i = 1; i < network.GetLayers().size(); i++) {
+      conv_network.AddLayer(network.GetLayers()[i]);
+    }
+  }
+
+  // The cache persists across frames, so sequences benefit the most
+  std::unique_ptr<NeighbourhoodCache> cache;
+  if (cache_mb > 0) {
+    cache = std::make_unique<NeighbourhoodCache>(cache_mb << 20);
+  }
+
+  if (sequence) {
+    FramePipeline::Filter filter;
+    std::unique_ptr<IncrementalFilter> incremental_filter;
+    if (cache) {
+      filter = [&](const cv::Mat& frame) {
+        return filterImageCached(network, *cache, frame);
+      };
+    } else if (incremental) {
+      incremental_filter =
+          std::make_unique<IncrementalFilter>(network, tile_size);
+      filter = [&](const cv::Mat& frame) {
+        cv::Mat out_img = incremental_filter->filter(frame);
+        incremental_filter->lastStats().print();
+        return out_img;
+      };
+    } else if (use_conv) {
+      filter = [&](const cv::Mat& frame) {
+        return filterImageConv(conv_network, *conv, frame);
+      };
+    } else {
+      filter = [&](const cv::Mat& frame) {
+        return filterImage(network, frame);
+      };
+    }
+
+    // The model is loaded once for the whole sequence and never rewritten
+    FramePipeline pipeline(filter);
+    try {
+      pipeline.run(input_filename, output_filename).print();
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    if (cache) cache->stats().print();
+    return 0;
+  }
+
+  if (cache) {
+    processImageCached(network, *cache, input_filename, output_filename);
+    cache->stats().print();
+  } else if (use_conv) {
+    processImageConv(conv_network, *conv, input_filename, output_filename);
+  } else if (stream) {
+    processImageStreaming(network, input_filename, output_filename, band_rows);
+  } else {
+    processImage(network, input_filename, output_filename);
+  }
 
   // Save the network
   std::ofstream file_out("../network.bin", std::ios::binary);
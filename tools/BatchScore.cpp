@@ -0,0 +1,337 @@
+// Scores a raw feature file with a saved network. The input is N rows of
+// little-endian floats or doubles, as many per row as the network has inputs,
+// with no header; the output gets N rows of predictions of the same type.
+//
+//   BatchScore network.bin features.bin predictions.bin [--type float]
+//              [--threads <cores>] [--batch 65536]
+//
+// Both files are memory mapped and worked through in chunks of --batch rows,
+// handed out to the threads in order. Each thread runs its own copy of the
+// layers (Network keeps per-layer output buffers, so one can't be shared)
+// over its chunk a micro-batch at a time. Doubles are read by the first layer
+// straight from the input mapping; floats have to be widened to doubles
+// first, one micro-batch at a time into a reused Matrix that stays in cache.
+// Each micro-batch's predictions are converted from the last layer's output
+// straight into the output mapping. Finished chunks are dropped from both
+// mappings, so files larger than RAM only keep the chunks in flight resident.
+// Only dense networks are supported.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Network.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A whole file mapped shared, read-only or read-write
+class MappedFile {
+ public:
+  // Maps an existing file for reading
+  explicit MappedFile(const std::string& path) {
+    m_fd = open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) throw std::runtime_error("Failed to open the file: " + path);
+    m_size = static_cast<size_t>(lseek(m_fd, 0, SEEK_END));
+    map(PROT_READ, path);
+  }
+
+  // Creates (or truncates) a file of size bytes and maps it for writing
+  MappedFile(const std::string& path, size_t size) : m_size(size) {
+    m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) throw std::runtime_error("Failed to open the file: " + path);
+    if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+      close(m_fd);
+      throw std::runtime_error("Failed to resize the file: " + path);
+    }
+    map(PROT_READ | PROT_WRITE, path);
+  }
+
+  ~MappedFile() {
+    if (m_data != nullptr) munmap(m_data, m_size);
+    close(m_fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  char* data() const { return static_cast<char*>(m_data); }
+  size_t size() const { return m_size; }
+
+  // Asks for the byte range [offset, offset + length) to be read ahead
+  void prefetch(size_t offset, size_t length) const {
+    if (m_data == nullptr || length == 0) return;
+    size_t begin = offset / pageSize() * pageSize();
+    madvise(data() + begin, std::min(offset + length, m_size) - begin,
+            MADV_WILLNEED);
+  }
+
+  // Drops the pages entirely inside [offset, offset + length) from the
+  // mapping. Dirty pages of a shared mapping stay in the page cache for
+  // writeback; pages shared with a neighbouring chunk are left alone, since
+  // another thread may still be using them.
+  void release(size_t offset, size_t length) const {
+    if (m_data == nullptr) return;
+    size_t begin = (offset + pageSize() - 1) / pageSize() * pageSize();
+    size_t end = offset + length;
+    if (end != m_size) end = end / pageSize() * pageSize();
+    if (begin < end) madvise(data() + begin, end - begin, MADV_DONTNEED);
+  }
+
+  // Writes dirty pages back, waiting for them
+  void sync() const {
+    if (m_data != nullptr) msync(m_data, m_size, MS_SYNC);
+  }
+
+ private:
+  int m_fd = -1;
+  void* m_data = nullptr;
+  size_t m_size = 0;
+
+  static size_t pageSize() {
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page;
+  }
+
+  void map(int protection, const std::string& path) {
+    if (m_size == 0) return;
+    m_data = mmap(nullptr, m_size, protection, MAP_SHARED, m_fd, 0);
+    if (m_data == MAP_FAILED) {
+      m_data = nullptr;
+      close(m_fd);
+      throw std::runtime_error("Failed to map the file: " + path);
+    }
+    madvise(m_data, m_size, MADV_SEQUENTIAL);
+  }
+};
+
+// The layers of one thread's network, copied from the loaded one
+struct Scorer {
+  std::vector<std::unique_ptr<LayerDense>> Layers;
+  Network Net;
+  // Widened float inputs, one micro-batch at a time
+  Matrix Inputs;
+  size_t MicroBatch = 0;
+
+  Scorer(const std::vector<const LayerDense*>& layers)
+      : Net(nullptr, 1), Inputs(0, 0) {
+    for (const LayerDense* source : layers) {
+      Layers.push_back(std::make_unique<LayerDense>(
+          source->getWeights().numRows(), source->getWeights().numColumns(),
+          source->getActivation()));
+      Layers.back()->setWeights(source->getWeights());
+      Layers.back()->setBiases(source->getBiases());
+      Net.AddLayer(Layers.back().get());
+    }
+    MicroBatch = Net.MicroBatchRows();
+  }
+};
+
+template <typename T>
+void scoreChunk(Scorer& scorer, const T* in, T* out, size_t rows,
+                size_t inputs) {
+  auto store = [out](size_t first, const Matrix& predictions) {
+    size_t cols = predictions.numColumns();
+    const double* results = predictions.data();
+    T* dest = out + first * cols;
+    for (size_t i = 0; i < predictions.numRows() * cols; i++) {
+      dest[i] = static_cast<T>(results[i]);
+    }
+  };
+
+  if constexpr (std::is_same_v<T, double>) {
+    scorer.Net.ForwardRows(in, rows, inputs, store);
+  } else {
+    for (size_t begin = 0; begin < rows; begin += scorer.MicroBatch) {
+      size_t count = std::min(scorer.MicroBatch, rows - begin);
+      scorer.Inputs.resize(count, inputs);
+      double* values = scorer.Inputs.data();
+      const T* row = in + begin * inputs;
+      for (size_t i = 0; i < count * inputs; i++) values[i] = row[i];
+
+      scorer.Net.ForwardRows(
+          values, count, inputs,
+          [&](size_t first, const Matrix& predictions) {
+            store(begin + first, predictions);
+          });
+    }
+  }
+}
+
+template <typename T>
+void scoreFile(const std::vector<const LayerDense*>& layers,
+               const MappedFile& input, MappedFile& output, size_t rows,
+               size_t batch, size_t threads) {
+  size_t inputs = layers.front()->getWeights().numRows();
+  size_t outputs = layers.back()->getWeights().numColumns();
+  size_t in_row_bytes = inputs * sizeof(T);
+  size_t out_row_bytes = outputs * sizeof(T);
+  size_t chunks = (rows + batch - 1) / batch;
+
+  std::atomic<size_t> next_chunk(0);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto work = [&]() {
+    try {
+      Scorer scorer(layers);
+      for (;;) {
+        size_t chunk = next_chunk.fetch_add(1);
+        if (chunk >= chunks) break;
+        size_t first = chunk * batch;
+        size_t count = std::min(batch, rows - first);
+
+        // Start reading this thread's next chunk while this one runs
+        size_t ahead = first + threads * batch;
+        if (ahead < rows) {
+          input.prefetch(ahead * in_row_bytes,
+                         std::min(batch, rows - ahead) * in_row_bytes);
+        }
+
+        scoreChunk(scorer,
+                   reinterpret_cast<const T*>(input.data() +
+                                              first * in_row_bytes),
+                   reinterpret_cast<T*>(output.data() + first * out_row_bytes),
+                   count, inputs);
+
+        input.release(first * in_row_bytes, count * in_row_bytes);
+        output.release(first * out_row_bytes, count * out_row_bytes);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) error = std::current_exception();
+      next_chunk = chunks;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < threads; i++) workers.emplace_back(work);
+  work();
+  for (std::thread& worker : workers) worker.join();
+  if (error) std::rethrow_exception(error);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <network> <features> <predictions> [--type float|double]"
+                 " [--threads n] [--batch rows]"
+              << std::endl;
+    return 1;
+  }
+  std::string network_filename = argv[1];
+  std::string features_filename = argv[2];
+  std::string predictions_filename = argv[3];
+  std::string type = "float";
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t batch = 65536;
+
+  for (int i = 4; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return 1;
+    }
+    if (arg == "--type") {
+      type = argv[++i];
+    } else if (arg == "--threads") {
+      threads = std::stoul(argv[++i]);
+    } else if (arg == "--batch") {
+      batch = std::stoul(argv[++i]);
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  if (type != "float" && type != "double") {
+    std::cerr << "--type must be float or double." << std::endl;
+    return 1;
+  }
+  if (threads < 1 || batch < 1) {
+    std::cerr << "Threads and batch must be at least 1." << std::endl;
+    return 1;
+  }
+  if constexpr (std::endian::native != std::endian::little) {
+    std::cerr << "Feature files are little-endian; this host isn't."
+              << std::endl;
+    return 1;
+  }
+
+  std::ifstream file_in(network_filename, std::ios::binary);
+  if (!file_in.is_open()) {
+    std::cerr << "Failed to open the file: " << network_filename << std::endl;
+    return 1;
+  }
+  Network network(nullptr, 1);
+  network.Load(file_in);
+
+  std::vector<const LayerDense*> layers;
+  for (const Layer* layer : network.GetLayers()) {
+    const LayerDense* dense = dynamic_cast<const LayerDense*>(layer);
+    if (dense == nullptr) {
+      std::cerr << "Only dense networks can score feature files." << std::endl;
+      return 1;
+    }
+    layers.push_back(dense);
+  }
+  if (layers.empty()) {
+    std::cerr << "Network has no layers." << std::endl;
+    return 1;
+  }
+
+  size_t element = type == "float" ? sizeof(float) : sizeof(double);
+  size_t inputs = layers.front()->getWeights().numRows();
+  size_t outputs = layers.back()->getWeights().numColumns();
+
+  try {
+    MappedFile features(features_filename);
+    if (features.size() % (inputs * element) != 0) {
+      std::cerr << features_filename << " is not a whole number of " << inputs
+                << "-wide " << type << " rows." << std::endl;
+      return 1;
+    }
+    size_t rows = features.size() / (inputs * element);
+    MappedFile predictions(predictions_filename, rows * outputs * element);
+
+    Clock::time_point start = Clock::now();
+    if (type == "float") {
+      scoreFile<float>(layers, features, predictions, rows, batch, threads);
+    } else {
+      scoreFile<double>(layers, features, predictions, rows, batch, threads);
+    }
+    double score_seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    predictions.sync();
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << "Scored " << rows << " rows (" << inputs << " -> " << outputs
+              << ", " << type << ") on " << threads << " threads in "
+              << seconds << " s" << std::endl;
+    std::cout << "  " << rows / score_seconds / 1e6
+              << " M rows/s scoring, " << rows / seconds / 1e6
+              << " M rows/s including writeback" << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,251 @@
+// Compiles a saved network into standalone C++: <prefix>.h declares
+//
+//   void <namespace>::infer(const float* in, float* out, size_t n);
+//
+// and <prefix>.cpp holds the weights as aligned constexpr arrays and one
+// straight-line block per layer, so the model needs no loading at startup and
+// every shape is known to the compiler. Only dense layers are supported, and
+// the unrolled code grows with the weight count, so this is meant for small
+// fixed models like the image network.
+//
+//   ModelCompiler network.bin <output prefix> [namespace = compiled_model]
+//
+// `make verify-model MODEL=network.bin` checks the result against
+// Network::Forward.
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Network.h"
+
+namespace {
+
+// Non-finite values (including doubles too large for a float) have no
+// literal, so they are spelled through numeric_limits
+std::string literal(double value) {
+  float rounded = static_cast<float>(value);
+  if (std::isnan(rounded)) return "std::numeric_limits<float>::quiet_NaN()";
+  if (std::isinf(rounded)) {
+    return rounded > 0 ? "std::numeric_limits<float>::infinity()"
+                       : "-std::numeric_limits<float>::infinity()";
+  }
+  std::ostringstream out;
+  out.precision(std::numeric_limits<float>::max_digits10);
+  out << std::showpoint << rounded << "f";
+  return out.str();
+}
+
+const char* activationName(ActivationMethod method) {
+  switch (method) {
+    case ActivationMethod::ReLU:
+      return "ReLU";
+    case ActivationMethod::Sigmoid:
+      return "Sigmoid";
+    case ActivationMethod::Softmax:
+      return "Softmax";
+    default:
+      return nullptr;
+  }
+}
+
+// Weights are stored transposed, one contiguous row of inputs per neuron, so
+// each output is a dot product over adjacent constants
+void emitWeights(std::ostream& out, const LayerDense& layer, size_t index) {
+  const Matrix& weights = layer.getWeights();
+  const Matrix& biases = layer.getBiases();
+  size_t inputs = weights.numRows(), neurons = weights.numColumns();
+
+  out << "alignas(64) constexpr float kWeights" << index << "[" << neurons
+      << " * " << inputs << "] = {";
+  for (size_t n = 0; n < neurons; n++) {
+    out << "\n   ";
+    for (size_t k = 0; k < inputs; k++) {
+      out << " " << literal(weights(k, n)) << ",";
+    }
+  }
+  out << "\n};\n";
+
+  out << "alignas(64) constexpr float kBiases" << index << "[" << neurons
+      << "] = {";
+  for (size_t n = 0; n < neurons; n++) {
+    out << (n % 6 == 0 ? "\n    " : " ") << literal(biases(0, n)) << ",";
+  }
+  out << "\n};\n\n";
+}
+
+// Writes a<index>[n] = in . weights + bias for every neuron, then the
+// activation in place, matching LayerDense::forward and Activation::forward
+void emitLayer(std::ostream& out, const LayerDense& layer, size_t index,
+               const std::string& input) {
+  size_t inputs = layer.getWeights().numRows();
+  size_t neurons = layer.getWeights().numColumns();
+  ActivationMethod activation = layer.getActivation();
+  std::string a = "a" + std::to_string(index);
+  std::string w = "kWeights" + std::to_string(index);
+
+  out << "    // Layer " << index << ": dense " << inputs << " -> " << neurons
+      << ", " << activationName(activation) << "\n";
+  out << "    float " << a << "[" << neurons << "];\n";
+  for (size_t n = 0; n < neurons; n++) {
+    out << "    " << a << "[" << n << "] =";
+    for (size_t k = 0; k < inputs; k++) {
+      out << (k == 0 ? " " : " + ") << input << "[" << k << "] * " << w << "["
+          << n * inputs + k << "]";
+    }
+    out << " + kBiases" << index << "[" << n << "];\n";
+  }
+
+  switch (activation) {
+    case ActivationMethod::ReLU:
+      for (size_t n = 0; n < neurons; n++) {
+        out << "    " << a << "[" << n << "] = std::max(0.0f, " << a << "["
+            << n << "]);\n";
+      }
+      break;
+
+    case ActivationMethod::Sigmoid:
+      for (size_t n = 0; n < neurons; n++) {
+        out << "    " << a << "[" << n << "] = 1.0f / (1.0f + std::exp(-" << a
+            << "[" << n << "]));\n";
+      }
+      break;
+
+    case ActivationMethod::Softmax: {
+      std::string m = "max" + std::to_string(index);
+      std::string s = "sum" + std::to_string(index);
+      out << "    float " << m << " = " << a << "[0];\n";
+      for (size_t n = 1; n < neurons; n++) {
+        out << "    " << m << " = std::max(" << m << ", " << a << "[" << n
+            << "]);\n";
+      }
+      out << "    float " << s << " = 0.0f;\n";
+      for (size_t n = 0; n < neurons; n++) {
+        out << "    " << a << "[" << n << "] = std::exp(" << a << "[" << n
+            << "] - " << m << ");\n";
+        out << "    " << s << " += " << a << "[" << n << "];\n";
+      }
+      for (size_t n = 0; n < neurons; n++) {
+        out << "    " << a << "[" << n << "] /= " << s << ";\n";
+      }
+      break;
+    }
+
+    default:
+      // main() rejects the rest, as Activation::forward does
+      break;
+  }
+  out << "\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <network.bin> <output prefix> [namespace]" << std::endl;
+    return 1;
+  }
+  std::string network_filename = argv[1];
+  std::filesystem::path prefix = argv[2];
+  std::string name = argc > 3 ? argv[3] : "compiled_model";
+
+  std::ifstream file_in(network_filename, std::ios::binary);
+  if (!file_in.good()) {
+    std::cerr << "Failed to open the file: " << network_filename << std::endl;
+    return 1;
+  }
+  Network network(nullptr, 1);
+  network.Load(file_in);
+
+  std::vector<const LayerDense*> layers;
+  for (const Layer* layer : network.GetLayers()) {
+    const LayerDense* dense = dynamic_cast<const LayerDense*>(layer);
+    if (dense == nullptr) {
+      std::cerr << "Only dense layers can be compiled." << std::endl;
+      return 1;
+    }
+    if (!layers.empty() &&
+        layers.back()->getWeights().numColumns() !=
+            dense->getWeights().numRows()) {
+      std::cerr << "Layer sizes don't chain." << std::endl;
+      return 1;
+    }
+    if (activationName(dense->getActivation()) == nullptr) {
+      // The interpreter throws on these, so there is no reference to match
+      std::cerr << "Unsupported activation method." << std::endl;
+      return 1;
+    }
+    layers.push_back(dense);
+  }
+  if (layers.empty()) {
+    std::cerr << "Network has no layers." << std::endl;
+    return 1;
+  }
+
+  size_t inputs = layers.front()->getWeights().numRows();
+  size_t outputs = layers.back()->getWeights().numColumns();
+  std::string source_name =
+      std::filesystem::path(network_filename).filename().string();
+
+  std::filesystem::path header_path = prefix;
+  header_path += ".h";
+  std::filesystem::path source_path = prefix;
+  source_path += ".cpp";
+
+  std::ofstream header(header_path);
+  std::ofstream source(source_path);
+  if (!header.is_open() || !source.is_open()) {
+    std::cerr << "Failed to open the file: " << prefix.string() << ".{h,cpp}"
+              << std::endl;
+    return 1;
+  }
+
+  header << "// Generated by ModelCompiler from " << source_name
+         << ". Do not edit.\n"
+         << "#pragma once\n\n"
+         << "#include <cstddef>\n\n"
+         << "namespace " << name << " {\n\n"
+         << "constexpr size_t kInputs = " << inputs << ";\n"
+         << "constexpr size_t kOutputs = " << outputs << ";\n\n"
+         << "// Runs n rows of kInputs floats through the network, writing "
+            "kOutputs\n"
+         << "// floats per row to out\n"
+         << "void infer(const float* in, float* out, size_t n);\n\n"
+         << "}  // namespace " << name << "\n";
+
+  source << "// Generated by ModelCompiler from " << source_name
+         << ". Do not edit.\n"
+         << "#include \"" << header_path.filename().string() << "\"\n\n"
+         << "#include <algorithm>\n"
+         << "#include <cmath>\n"
+         << "#include <limits>\n\n"
+         << "namespace " << name << " {\n\n"
+         << "namespace {\n\n";
+  for (size_t i = 0; i < layers.size(); i++) {
+    emitWeights(source, *layers[i], i);
+  }
+  source << "}  // namespace\n\n"
+         << "void infer(const float* in, float* out, size_t n) {\n"
+         << "  for (size_t row = 0; row < n; row++, in += kInputs, "
+            "out += kOutputs) {\n";
+  std::string input = "in";
+  for (size_t i = 0; i < layers.size(); i++) {
+    emitLayer(source, *layers[i], i, input);
+    input = "a" + std::to_string(i);
+  }
+  source << "    for (size_t i = 0; i < kOutputs; i++) out[i] = " << input
+         << "[i];\n"
+         << "  }\n"
+         << "}\n\n"
+         << "}  // namespace " << name << "\n";
+
+  std::cout << "Wrote " << header_path.string() << " and "
+            << source_path.string() << " (" << inputs << " -> " << outputs
+            << ", " << layers.size() << " layers)" << std::endl;
+  return 0;
+}
@@ -0,0 +1,167 @@
+// Converts a binary trace written by the Instrumentor into Chrome tracing
+// JSON (chrome://tracing, Perfetto). Records are streamed, so only the name
+// table is held in memory.
+//
+//   TraceToJson results.trace [results.json]
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PerfCounters.h"
+#include "TraceFormat.h"
+
+namespace {
+
+std::string readText(std::ifstream& in, uint32_t length) {
+  std::string text(length, '\0');
+  in.read(text.data(), length);
+  // Quotes in names (e.g. from __PRETTY_FUNCTION__) would end the JSON string
+  std::replace(text.begin(), text.end(), '"', '\'');
+  return text;
+}
+
+const std::string& lookup(const std::vector<std::string>& names,
+                          uint32_t id) {
+  static const std::string unknown = "(unknown)";
+  return id < names.size() ? names[id] : unknown;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <trace> [output.json]" << std::endl;
+    return 1;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in.is_open()) {
+    std::cerr << "Failed to open the file: " << argv[1] << std::endl;
+    return 1;
+  }
+
+  char magic[sizeof(Trace::kMagic)];
+  in.read(magic, sizeof(magic));
+  if (!in || std::memcmp(magic, Trace::kMagic, sizeof(magic)) != 0) {
+    std::cerr << argv[1] << " is not an Instrumentor trace" << std::endl;
+    return 1;
+  }
+
+  std::string outPath = argc > 2 ? argv[2] : "results.json";
+  std::ofstream out(outPath);
+  if (!out.is_open()) {
+    std::cerr << "Failed to open the file: " << outPath << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> names;
+  size_t written = 0;
+  bool ended = false;
+
+  Trace::Record record;
+  Trace::CounterPayload counters;
+  Trace::AllocationPayload allocations;
+  while (!ended && in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+    switch (record.Kind) {
+      case Trace::RecordKind::Session:
+        out << "{\"session\": \"" << readText(in, record.Length) << "\",";
+        out << "\"traceEvents\": [";
+        continue;
+      case Trace::RecordKind::Name:
+        if (names.size() <= record.NameId) names.resize(record.NameId + 1);
+        names[record.NameId] = readText(in, record.Length);
+        continue;
+      case Trace::RecordKind::End:
+        if (record.Value > 0) {
+          std::cerr << "Trace dropped " << record.Value
+                    << " events from full buffers" << std::endl;
+        }
+        ended = true;
+        continue;
+      case Trace::RecordKind::Counters:
+        if (record.Length != sizeof(counters)) {
+          std::cerr << "Malformed counter record" << std::endl;
+          return 1;
+        }
+        in.read(reinterpret_cast<char*>(&counters), sizeof(counters));
+        break;
+      case Trace::RecordKind::Allocations:
+        if (record.Length != sizeof(allocations)) {
+          std::cerr << "Malformed allocation record" << std::endl;
+          return 1;
+        }
+        in.read(reinterpret_cast<char*>(&allocations), sizeof(allocations));
+        break;
+      default:
+        break;
+    }
+
+    if (written++ > 0) out << ",";
+    out << "{";
+    switch (record.Kind) {
+      case Trace::RecordKind::Event:
+        out << "\"cat\": \"Function Runtime\",";
+        out << "\"dur\":" << (record.Value - record.Start) << ',';
+        out << "\"name\":\"" << lookup(names, record.NameId) << "\",";
+        out << "\"ph\": \"X\",";
+        out << "\"pid\": 0,";
+        out << "\"tid\":" << record.ThreadID << ",";
+        break;
+      case Trace::RecordKind::Count:
+        out << "\"cat\": \"Function Call Count\",";
+        out << "\"args\":{\"Count\":" << record.Value << "},";
+        out << "\"name\":\"_c " << lookup(names, record.NameId) << "\",";
+        out << "\"ph\": \"C\",";
+        out << "\"pid\": 65536,";
+        out << "\"tid\": 0,";
+        break;
+      case Trace::RecordKind::TotalTime:
+        out << "\"cat\": \"Function Total Runtime\",";
+        out << "\"dur\":" << record.Value << ',';
+        out << "\"name\":\"_tr " << lookup(names, record.NameId) << "\",";
+        out << "\"ph\": \"X\",";
+        out << "\"pid\": 0,";
+        out << "\"tid\": 1,";
+        break;
+      case Trace::RecordKind::Allocations:
+        out << "\"cat\": \"Heap Allocations\",";
+        out << "\"args\":{\"Count\":" << allocations.Count
+            << ",\"Bytes\":" << allocations.Bytes << "},";
+        out << "\"name\":\"_a " << lookup(names, record.NameId) << "\",";
+        out << "\"ph\": \"C\",";
+        out << "\"pid\": 65536,";
+        out << "\"tid\": 0,";
+        break;
+      case Trace::RecordKind::Counters:
+        out << "\"cat\": \"Hardware Counters\",";
+        out << "\"args\":{";
+        for (size_t i = 0; i < kPerfCounterCount; i++) {
+          if (!(counters.Available & (1u << i))) continue;
+          out << "\"" << perfCounterName(static_cast<PerfCounter>(i))
+              << "\":" << counters.Values[i] << ",";
+        }
+        out << "\"cpu_time_us\":" << counters.CpuTimeNs / 1000.0 << "},";
+        out << "\"name\":\"" << lookup(names, record.NameId) << "\",";
+        out << "\"ph\": \"C\",";
+        out << "\"pid\": 0,";
+        out << "\"tid\":" << record.ThreadID << ",";
+        break;
+      default:
+        std::cerr << "Unknown record kind "
+                  << static_cast<uint32_t>(record.Kind) << std::endl;
+        return 1;
+    }
+    out << "\"ts\":" << record.Start;
+    out << "}";
+  }
+
+  if (!ended) {
+    std::cerr << "Trace ends early; the session was not closed" << std::endl;
+  }
+  out << "]}";
+  std::cout << "Wrote " << written << " events to " << outPath << std::endl;
+  return 0;
+}
@@ -0,0 +1,91 @@
+// Checks code generated by ModelCompiler against the interpreted network it
+// was compiled from, on random inputs and several batch sizes, and reports
+// the time per row of each. Built and run by `make verify-model`, which
+// compiles it together with the generated CompiledModel.cpp.
+//
+//   CompiledModelCheck network.bin [tolerance = 1e-4]
+//
+// The generated code runs in float and the network in double, so outputs are
+// compared to within tolerance * max(1, |expected|). Exits 1 on a mismatch.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CompiledModel.h"
+#include "Network.h"
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <network.bin> [tolerance]"
+              << std::endl;
+    return 1;
+  }
+  std::string network_filename = argv[1];
+  double tolerance = argc > 2 ? std::stod(argv[2]) : 1e-4;
+
+  std::ifstream file_in(network_filename, std::ios::binary);
+  if (!file_in.good()) {
+    std::cerr << "Failed to open the file: " << network_filename << std::endl;
+    return 1;
+  }
+  Network network(nullptr, 1);
+  network.Load(file_in);
+
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  size_t failures = 0;
+
+  for (size_t rows : {1, 7, 1918, 65536}) {
+    // Inputs are exactly representable as floats, so both sides see the same
+    Matrix input(rows, compiled_model::kInputs);
+    std::vector<float> in(rows * compiled_model::kInputs);
+    for (size_t i = 0; i < in.size(); i++) {
+      in[i] = static_cast<float>(distribution(gen));
+      input.data()[i] = in[i];
+    }
+    std::vector<float> out(rows * compiled_model::kOutputs);
+
+    auto start = std::chrono::steady_clock::now();
+    network.SetInputs(&input);
+    network.Forward();
+    auto middle = std::chrono::steady_clock::now();
+    compiled_model::infer(in.data(), out.data(), rows);
+    auto end = std::chrono::steady_clock::now();
+
+    if (network.outputs->numRows() != rows ||
+        network.outputs->numColumns() != compiled_model::kOutputs) {
+      std::cerr << "Network output shape doesn't match the compiled model."
+                << std::endl;
+      return 1;
+    }
+
+    double max_error = 0.0;
+    for (size_t i = 0; i < out.size(); i++) {
+      double expected = network.outputs->data()[i];
+      double error =
+          std::abs(out[i] - expected) / std::max(1.0, std::abs(expected));
+      if (!(error <= tolerance)) failures++;
+      if (!(error <= max_error)) max_error = error;
+    }
+
+    double interpreted =
+        std::chrono::duration<double, std::nano>(middle - start).count();
+    double compiled =
+        std::chrono::duration<double, std::nano>(end - middle).count();
+    std::cout << "batch " << rows << ": max error " << max_error
+              << ", interpreted " << interpreted / rows << " ns/row, compiled "
+              << compiled / rows << " ns/row" << std::endl;
+  }
+
+  if (failures > 0) {
+    std::cout << failures << " output(s) differ by more than " << tolerance
+              << std::endl;
+    return 1;
+  }
+  std::cout << "Compiled model matches" << std::endl;
+  return 0;
+}
@@ -0,0 +1,93 @@
+// Checks that Network::Forward doesn't touch the heap once it is warm: each
+// input path runs once to size the layers' buffers, then again under
+// ASSERT_NO_ALLOCATIONS, which aborts with the allocation count if it
+// allocated. Built and run by `make verify-allocations`, which compiles the
+// library with PROFILE_ALLOCATIONS=1; the guard doesn't compile without it.
+//
+//   ForwardAllocationCheck
+//
+// Covers the network main.cpp builds, whose first layer takes 8-bit inputs
+// through a lookup table, and one with a first layer too wide for a table, in
+// double and 8-bit inputs and through ForwardRows, at a single row, a full
+// image row and a batch large enough to be split into micro-batches.
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "Instrumentor.h"
+#include "Network.h"
+
+namespace {
+
+void checkNetwork(const std::string& name, Network& network, size_t width,
+                  std::mt19937& gen) {
+  const Network::RowsCallback ignore = [](size_t, const Matrix&) {};
+
+  for (size_t rows : {size_t(1), size_t(1918), 4 * network.MicroBatchRows()}) {
+    Matrix inputs(rows, width);
+    ByteMatrix byte_inputs(rows, width);
+    for (size_t i = 0; i < rows * width; i++) {
+      byte_inputs.data()[i] = gen() & 0xFF;
+      inputs.data()[i] = byte_inputs.data()[i] / 255.0;
+    }
+    ByteMatrix byte_outputs(0, 0);
+    network.SetInputs(&inputs);
+
+    // Warm-up: sizes every buffer (and builds the first layer's lookup table)
+    network.Forward();
+    network.Forward(byte_inputs);
+    network.Forward(byte_inputs, byte_outputs);
+    network.ForwardRows(inputs.data(), rows, width, ignore);
+
+    // Each path again, at the size it was warmed up at
+    network.Forward();
+    {
+      ASSERT_NO_ALLOCATIONS("Network::Forward (double)");
+      network.Forward();
+    }
+    network.Forward(byte_inputs);
+    {
+      ASSERT_NO_ALLOCATIONS("Network::Forward (uint8)");
+      network.Forward(byte_inputs);
+    }
+    {
+      ASSERT_NO_ALLOCATIONS("Network::Forward (uint8 -> uint8)");
+      network.Forward(byte_inputs, byte_outputs);
+    }
+    {
+      ASSERT_NO_ALLOCATIONS("Network::ForwardRows");
+      network.ForwardRows(inputs.data(), rows, width, ignore);
+    }
+    std::cout << name << ", batch " << rows << ": no allocations" << std::endl;
+  }
+}
+
+}  // namespace
+
+int main() {
+  std::mt19937 gen(42);
+
+  // Same network as main.cpp
+  Network network(nullptr, 1);
+  LayerDense layer1(27, 9, ActivationMethod::Sigmoid);
+  LayerDense layer2(9, 6, ActivationMethod::ReLU);
+  LayerDense layer3(6, 3, ActivationMethod::Softmax);
+  network.AddLayer(&layer1);
+  network.AddLayer(&layer2);
+  network.AddLayer(&layer3);
+  checkNetwork("27-9-6-3", network, 27, gen);
+
+  // An 8x8 RGB patch: too wide for a lookup table, so 8-bit inputs are
+  // widened and multiplied instead
+  Network wide(nullptr, 1);
+  LayerDense wide1(192, 16, ActivationMethod::Sigmoid);
+  LayerDense wide2(16, 3, ActivationMethod::Softmax);
+  wide.AddLayer(&wide1);
+  wide.AddLayer(&wide2);
+  if (wide1.hasLookupTable()) {
+    std::cerr << "The wide layer unexpectedly has a lookup table." << std::endl;
+    return 1;
+  }
+  checkNetwork("192-16-3", wide, 192, gen);
+  return 0;
+}